@@ -0,0 +1,336 @@
+#include "apic.h"
+#include "paging.h"
+#include "clock.h"
+#include "pic.h"
+
+// ACPI system description table header
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_header_t;
+
+// Root system description pointer (ACPI 1.0 part)
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+} __attribute__((packed)) acpi_rsdp_t;
+
+// Multiple APIC description table; variable-length entries follow
+typedef struct {
+    acpi_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+} __attribute__((packed)) acpi_madt_t;
+
+// MADT entry types
+#define MADT_LAPIC 0
+#define MADT_IOAPIC 1
+#define MADT_OVERRIDE 2
+
+// Register windows
+static uint32_t lapic_base = 0;
+static uint32_t ioapic_base = 0;
+static uint32_t ioapic_gsi_base = 0;
+static int apic_on = 0;
+
+// CPUs from the MADT
+static uint32_t cpu_apic_ids[MAX_CPUS];
+static uint32_t cpu_count = 0;
+
+// ISA IRQ -> global system interrupt, with the override's MPS flags
+static uint32_t isa_gsi[APIC_ISA_IRQS];
+static uint16_t isa_flags[APIC_ISA_IRQS];
+
+// LAPIC timer counts per tick (set by the first lapic_timer_start())
+static uint32_t timer_count = 0;
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+void itoa_hex(uint32_t num, char *str);
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return *(volatile uint32_t *)(lapic_base + reg);
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)(lapic_base + reg) = value;
+}
+
+static inline uint32_t ioapic_read(uint32_t reg) {
+    *(volatile uint32_t *)ioapic_base = reg;
+    return *(volatile uint32_t *)(ioapic_base + 0x10);
+}
+
+static inline void ioapic_write(uint32_t reg, uint32_t value) {
+    *(volatile uint32_t *)ioapic_base = reg;
+    *(volatile uint32_t *)(ioapic_base + 0x10) = value;
+}
+
+// Busy-wait on the TSC clock (interrupts may be off)
+static void apic_delay_us(uint32_t us) {
+    uint64_t end = clock_monotonic_ns() + (uint64_t)us * 1000;
+    while (clock_monotonic_ns() < end) {
+        cpu_relax();
+    }
+}
+
+// ACPI tables are valid when all their bytes sum to zero
+static int acpi_checksum(const void *table, uint32_t length) {
+    const uint8_t *p = (const uint8_t *)table;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        sum += p[i];
+    }
+    return sum == 0;
+}
+
+// Look for "RSD PTR " on 16-byte boundaries in [start, end)
+static acpi_rsdp_t *acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += 16) {
+        const char *sig = (const char *)addr;
+        if (sig[0] == 'R' && sig[1] == 'S' && sig[2] == 'D' && sig[3] == ' ' &&
+            sig[4] == 'P' && sig[5] == 'T' && sig[6] == 'R' && sig[7] == ' ' &&
+            acpi_checksum((void *)addr, sizeof(acpi_rsdp_t))) {
+            return (acpi_rsdp_t *)addr;
+        }
+    }
+    return NULL;
+}
+
+// Find the MADT through the RSDP (first KB of the EBDA, then the BIOS
+// ROM area) and the RSDT
+static acpi_madt_t *acpi_find_madt(void) {
+    uint32_t ebda;
+    asm volatile("movzwl 0x40E, %0" : "=r"(ebda));  // EBDA segment from the BIOS data area
+    ebda <<= 4;
+    acpi_rsdp_t *rsdp = NULL;
+    if (ebda) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(0xE0000, 0x100000);
+    }
+    if (!rsdp || rsdp->rsdt_address >= PAGE_PHYS_LIMIT) {
+        return NULL;
+    }
+    
+    acpi_header_t *rsdt = (acpi_header_t *)rsdp->rsdt_address;
+    if (!acpi_checksum(rsdt, rsdt->length)) {
+        return NULL;
+    }
+    
+    uint32_t *entries = (uint32_t *)(rsdt + 1);
+    uint32_t count = (rsdt->length - sizeof(acpi_header_t)) / 4;
+    for (uint32_t i = 0; i < count; i++) {
+        acpi_header_t *table = (acpi_header_t *)entries[i];
+        if (entries[i] < PAGE_PHYS_LIMIT && table->signature[0] == 'A' && table->signature[1] == 'P' &&
+            table->signature[2] == 'I' && table->signature[3] == 'C' &&
+            acpi_checksum(table, table->length)) {
+            return (acpi_madt_t *)table;
+        }
+    }
+    return NULL;
+}
+
+// Record the CPUs, the first I/O APIC and the ISA overrides
+static void madt_parse(acpi_madt_t *madt) {
+    uint8_t *entry = (uint8_t *)(madt + 1);
+    uint8_t *end = (uint8_t *)madt + madt->header.length;
+    
+    while (entry + 2 <= end && entry[1] >= 2) {
+        switch (entry[0]) {
+            case MADT_LAPIC:
+                // Processor ID, APIC ID, flags (bit 0: enabled)
+                if ((*(uint32_t *)(entry + 4) & 1) && cpu_count < MAX_CPUS) {
+                    cpu_apic_ids[cpu_count++] = entry[3];
+                }
+                break;
+            case MADT_IOAPIC:
+                if (!ioapic_base) {
+                    ioapic_base = *(uint32_t *)(entry + 4);
+                    ioapic_gsi_base = *(uint32_t *)(entry + 8);
+                }
+                break;
+            case MADT_OVERRIDE:
+                // Bus, source IRQ, GSI, MPS flags
+                if (entry[3] < APIC_ISA_IRQS) {
+                    isa_gsi[entry[3]] = *(uint32_t *)(entry + 4);
+                    isa_flags[entry[3]] = *(uint16_t *)(entry + 8);
+                }
+                break;
+        }
+        entry += entry[1];
+    }
+}
+
+// Send an ISA IRQ to a vector on one CPU
+static void ioapic_route(uint32_t irq, uint32_t vector, uint32_t apic_id) {
+    uint32_t pin = isa_gsi[irq] - ioapic_gsi_base;
+    uint32_t low = vector;
+    
+    // MPS flags: polarity in bits 0-1, trigger mode in bits 2-3 (3 = low / level)
+    if ((isa_flags[irq] & 0x3) == 0x3) {
+        low |= IOAPIC_ACTIVE_LOW;
+    }
+    if (((isa_flags[irq] >> 2) & 0x3) == 0x3) {
+        low |= IOAPIC_LEVEL;
+    }
+    
+    ioapic_write(IOAPIC_REDIRECTION + pin * 2 + 1, apic_id << 24);
+    ioapic_write(IOAPIC_REDIRECTION + pin * 2, low);
+}
+
+// Switch interrupt delivery from the 8259 to the APICs
+int apic_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    char buffer[16];
+    
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_APIC)) {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < APIC_ISA_IRQS; i++) {
+        isa_gsi[i] = i;
+        isa_flags[i] = 0;
+    }
+    
+    acpi_madt_t *madt = acpi_find_madt();
+    if (!madt) {
+        console_puts("APIC: no ACPI MADT, staying on the 8259\n");
+        return 0;
+    }
+    madt_parse(madt);
+    if (!ioapic_base || cpu_count == 0) {
+        console_puts("APIC: no I/O APIC, staying on the 8259\n");
+        return 0;
+    }
+    
+    // Both register windows sit above the identity map
+    lapic_base = madt->lapic_address;
+    paging_map_mmio(lapic_base);
+    paging_map_mmio(ioapic_base);
+    lapic_init();
+    
+    // Mask every input, then route the PIT and the keyboard to this CPU
+    uint32_t inputs = ((ioapic_read(IOAPIC_VERSION) >> 16) & 0xFF) + 1;
+    for (uint32_t i = 0; i < inputs; i++) {
+        ioapic_write(IOAPIC_REDIRECTION + i * 2, IOAPIC_MASKED);
+    }
+    ioapic_route(0, 0x20, lapic_id());
+    ioapic_route(1, 0x21, lapic_id());
+    
+    pic_disable();
+    apic_on = 1;
+    
+    console_puts("APIC: ");
+    itoa(cpu_count, buffer);
+    console_puts(buffer);
+    console_puts(" CPU(s), I/O APIC at ");
+    itoa_hex(ioapic_base, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    return cpu_count;
+}
+
+// Returns 1 once interrupts come through the APICs
+int apic_enabled(void) {
+    return apic_on;
+}
+
+// CPUs listed in the MADT
+uint32_t apic_cpu_count(void) {
+    return cpu_count;
+}
+
+// Local APIC ID of a MADT CPU
+uint32_t apic_cpu_apic_id(uint32_t index) {
+    return (index < cpu_count) ? cpu_apic_ids[index] : 0;
+}
+
+// Enable the executing CPU's local APIC
+void lapic_init(void) {
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// Local APIC ID of the executing CPU
+uint32_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+// Write the ICR and wait for the APIC to accept the IPI
+static void lapic_send(uint32_t apic_id, uint32_t command) {
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) {
+        cpu_relax();
+    }
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) {
+        cpu_relax();
+    }
+}
+
+// Fixed-delivery IPI
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector) {
+    uint32_t flags = irq_save();
+    lapic_send(apic_id, vector);
+    irq_restore(flags);
+}
+
+// INIT IPI: resets the target into wait-for-SIPI
+void lapic_send_init(uint32_t apic_id) {
+    lapic_send(apic_id, ICR_INIT | ICR_ASSERT | ICR_LEVEL);
+    apic_delay_us(10000);
+}
+
+// Startup IPI: the target starts in real mode at page << 12
+void lapic_send_startup(uint32_t apic_id, uint32_t page) {
+    lapic_send(apic_id, ICR_STARTUP | (page & 0xFF));
+    apic_delay_us(200);
+}
+
+// Periodic LAPIC timer. The bus clock is shared, so one calibration
+// against the TSC serves every CPU.
+void lapic_timer_start(uint32_t hz) {
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    
+    if (timer_count == 0) {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+        lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+        apic_delay_us(APIC_TIMER_CALIBRATE_MS * 1000);
+        uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+        lapic_write(LAPIC_TIMER_INIT, 0);
+        timer_count = elapsed * (1000 / APIC_TIMER_CALIBRATE_MS) / hz;
+    }
+    
+    lapic_write(LAPIC_LVT_TIMER, APIC_TIMER_VECTOR | LAPIC_TIMER_PERIODIC);
+    lapic_write(LAPIC_TIMER_INIT, timer_count);
+}
+
+// Acknowledge the current interrupt
+void irq_eoi(void) {
+    if (apic_on) {
+        lapic_write(LAPIC_EOI, 0);
+    } else {
+        outb(0x20, 0x20);
+    }
+}
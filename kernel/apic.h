@@ -0,0 +1,76 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// Local APIC registers (offsets from the LAPIC base)
+#define LAPIC_ID 0x020
+#define LAPIC_TPR 0x080
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+// Register bits
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_LVT_MASKED 0x10000
+#define LAPIC_TIMER_PERIODIC 0x20000
+#define LAPIC_TIMER_DIV16 0x3
+#define ICR_INIT 0x500
+#define ICR_STARTUP 0x600
+#define ICR_PENDING 0x1000
+#define ICR_ASSERT 0x4000
+#define ICR_LEVEL 0x8000
+
+// I/O APIC registers
+#define IOAPIC_VERSION 0x01
+#define IOAPIC_REDIRECTION 0x10    // Two registers per input
+#define IOAPIC_ACTIVE_LOW 0x2000
+#define IOAPIC_LEVEL 0x8000
+#define IOAPIC_MASKED 0x10000
+
+// Interrupt vectors owned by the APIC code
+#define RESCHED_VECTOR 0x31        // IPI: switch if something better is ready
+#define TLB_VECTOR 0x32            // IPI: reload CR3
+#define APIC_TIMER_VECTOR 0x40     // LAPIC timer on application processors
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// Limits and timing
+#define APIC_ISA_IRQS 16
+#define APIC_TIMER_CALIBRATE_MS 10
+
+// Find the CPUs and I/O APIC in the ACPI MADT, enable the boot CPU's
+// local APIC and route the timer and keyboard through the I/O APIC in
+// place of the 8259. Returns 0 (and leaves the 8259 alone) without a MADT.
+int apic_init(void);
+
+// Returns 1 once apic_init() switched to APIC interrupts
+int apic_enabled(void);
+
+// CPUs listed in the MADT, and their local APIC IDs
+uint32_t apic_cpu_count(void);
+uint32_t apic_cpu_apic_id(uint32_t index);
+
+// Local APIC of the executing CPU
+void lapic_init(void);
+uint32_t lapic_id(void);
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector);
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_startup(uint32_t apic_id, uint32_t page);
+
+// Start this CPU's LAPIC timer at hz on APIC_TIMER_VECTOR (calibrated
+// against the TSC on first use)
+void lapic_timer_start(uint32_t hz);
+
+// Acknowledge the interrupt being handled (LAPIC, or the 8259 before
+// apic_init())
+void irq_eoi(void);
+
+#endif // APIC_H
@@ -37,6 +37,10 @@ extern kernel_main
 _start:
     cli
     
+    ; Keep the multiboot2 magic (eax) and info pointer (ebx) for kernel_main
+    mov edi, eax
+    mov esi, ebx
+    
     ; Load GDT
     lgdt [gdt_ptr]
     
@@ -54,5 +58,7 @@ _start:
     jmp 0x08:reload_cs
     
 reload_cs:
+    push esi            ; multiboot2 info pointer
+    push edi            ; multiboot2 magic
     call kernel_main
     hlt
@@ -0,0 +1,148 @@
+#include "clock.h"
+#include "scheduler.h"
+
+// cycles -> ns is (cycles * clock_mult) >> clock_shift
+static uint32_t clock_mult = 0;
+static uint32_t clock_shift = 0;
+static uint32_t tsc_khz = 0;
+static uint64_t tsc_boot = 0;
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+// 64-by-32-bit division: the high word first, then divl on the remainder
+// and the low word (the quotient of that step always fits in 32 bits)
+uint64_t udiv64_32(uint64_t dividend, uint32_t divisor, uint32_t *remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quotient_high = high / divisor;
+    uint32_t quotient_low, rem;
+    
+    high %= divisor;
+    asm("divl %4" : "=a"(quotient_low), "=d"(rem) : "a"(low), "d"(high), "rm"(divisor));
+    
+    if (remainder) {
+        *remainder = rem;
+    }
+    return ((uint64_t)quotient_high << 32) | quotient_low;
+}
+
+// Count TSC cycles across one CLOCK_CALIBRATE_MS one-shot of PIT
+// channel 2; returns 0 if the channel never fires
+static uint32_t calibrate_run(void) {
+    const uint32_t count = CLOCK_PIT_FREQUENCY * CLOCK_CALIBRATE_MS / 1000;
+    
+    // Gate channel 2 on, keep the speaker off
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+    
+    // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(0x43, 0xB0);
+    outb(0x42, count & 0xFF);
+    outb(0x42, (count >> 8) & 0xFF);
+    
+    uint64_t start = rdtsc();
+    uint32_t spins = 0;
+    
+    // OUT2 (bit 5 of port 0x61) goes high at terminal count
+    while (!(inb(0x61) & 0x20)) {
+        if (++spins > 10000000) {
+            return 0;  // No PIT channel 2
+        }
+    }
+    
+    return (uint32_t)(rdtsc() - start);
+}
+
+// Calibrate the TSC and derive the cycles -> ns conversion
+void clock_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    char buffer[16];
+    
+    tsc_khz = 0;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 1) {
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+        if (edx & CPUID_EDX_TSC) {
+            // The shortest run had the fewest SMIs and emulation stalls
+            uint32_t best = 0;
+            for (uint32_t i = 0; i < CLOCK_CALIBRATE_RUNS; i++) {
+                uint32_t cycles = calibrate_run();
+                if (cycles && (best == 0 || cycles < best)) {
+                    best = cycles;
+                }
+            }
+            tsc_khz = best / CLOCK_CALIBRATE_MS;
+        }
+    }
+    
+    if (tsc_khz == 0) {
+        console_puts("Clock: no usable TSC, using the 100Hz tick\n");
+        return;
+    }
+    
+    // Largest shift whose multiplier still fits in 32 bits
+    clock_shift = 32;
+    while (1) {
+        uint64_t mult = udiv64_32((uint64_t)1000000 << clock_shift, tsc_khz, 0);
+        if (mult <= 0xFFFFFFFFu || clock_shift == 0) {
+            clock_mult = (uint32_t)mult;
+            break;
+        }
+        clock_shift--;
+    }
+    
+    tsc_boot = rdtsc();
+    
+    console_puts("Clock: TSC ");
+    itoa(tsc_khz / 1000, buffer);
+    console_puts(buffer);
+    console_puts(" MHz\n");
+}
+
+// Convert a cycle count to nanoseconds (96-bit product, done in halves)
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    uint64_t low = (uint64_t)(uint32_t)cycles * clock_mult;
+    uint64_t high = (uint64_t)(uint32_t)(cycles >> 32) * clock_mult;
+    return (high << (32 - clock_shift)) + (low >> clock_shift);
+}
+
+// Nanoseconds since clock_init()
+uint64_t clock_monotonic_ns(void) {
+    if (tsc_khz == 0) {
+        return (uint64_t)scheduler_get_ticks() * CLOCK_TICK_NS;
+    }
+    return clock_cycles_to_ns(rdtsc() - tsc_boot);
+}
+
+// Calibrated TSC frequency in kHz
+uint32_t clock_tsc_khz(void) {
+    return tsc_khz;
+}
+
+// Print a nanosecond timestamp as seconds.microseconds
+void clock_print_timestamp(uint64_t ns) {
+    char buffer[16];
+    uint32_t rem;
+    uint32_t seconds = (uint32_t)udiv64_32(ns, 1000000000, &rem);
+    uint32_t micros = rem / 1000;
+    
+    itoa(seconds, buffer);
+    console_puts(buffer);
+    console_puts(".");
+    for (uint32_t scale = 100000; scale > 1 && micros < scale; scale /= 10) {
+        console_puts("0");
+    }
+    itoa(micros, buffer);
+    console_puts(buffer);
+}
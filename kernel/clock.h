@@ -0,0 +1,36 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// Calibration and fallback constants
+#define CLOCK_PIT_FREQUENCY 1193182 // PIT input clock (Hz)
+#define CLOCK_CALIBRATE_MS 10       // PIT channel 2 window per calibration run
+#define CLOCK_CALIBRATE_RUNS 3      // The shortest of these runs is used
+#define CLOCK_TICK_NS 10000000      // Scheduler tick (100Hz PIT) when there is no TSC
+
+// Calibrate the TSC against PIT channel 2 (boot, interrupts off)
+void clock_init(void);
+
+// Raw cycle counter for cheap interval measurement
+static inline uint64_t clock_cycles(void) {
+    return rdtsc();
+}
+
+// Nanoseconds since clock_init()
+uint64_t clock_monotonic_ns(void);
+
+// Convert a cycle count to nanoseconds
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+// Calibrated TSC frequency in kHz (0 when the tick fallback is in use)
+uint32_t clock_tsc_khz(void);
+
+// 64-by-32-bit division (there is no libgcc for the 64-bit operators)
+uint64_t udiv64_32(uint64_t dividend, uint32_t divisor, uint32_t *remainder);
+
+// Print a nanosecond timestamp as seconds.microseconds
+void clock_print_timestamp(uint64_t ns);
+
+#endif // CLOCK_H
@@ -0,0 +1,117 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+// Highest number of CPUs the kernel keeps per-CPU state for
+#define MAX_CPUS 8
+
+// Per-CPU data written on hot paths gets a line of its own
+#define CACHE_LINE_SIZE 64
+
+// CPUID feature bits (leaf 1, EDX)
+#define CPUID_EDX_TSC (1u << 4)
+#define CPUID_EDX_APIC (1u << 9)
+#define CPUID_EDX_SSE2 (1u << 26)
+
+// Control register bits
+#define CR0_MP 0x00000002
+#define CR0_EM 0x00000004
+#define CR0_TS 0x00000008
+#define CR0_WP 0x00010000
+#define CR0_PG 0x80000000
+#define CR4_PSE 0x00000010
+#define CR4_OSFXSR 0x00000200
+#define CR4_OSXMMEXCPT 0x00000400
+
+// GDT selectors (see boot.asm) and EFLAGS bits
+#define KERNEL_CODE_SELECTOR 0x08
+#define KERNEL_DATA_SELECTOR 0x10
+#define EFLAGS_RESERVED 0x00000002 // Bit 1 always reads as set
+#define EFLAGS_IF 0x00000200
+
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    asm volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+// Read the time-stamp counter
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Disable interrupts, returning the previous EFLAGS
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Restore the interrupt flag saved by irq_save()
+static inline void irq_restore(uint32_t flags) {
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+// Index of the executing CPU: the id field of the per-CPU block GS
+// selects (cpu_t in smp.h, loaded by smp_init())
+static inline uint32_t cpu_current_id(void) {
+    uint32_t id;
+    asm volatile("mov %%gs:4, %0" : "=r"(id));
+    return id;
+}
+
+// Spin-wait hint
+static inline void cpu_relax(void) {
+    asm volatile("pause" : : : "memory");
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    asm volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    asm volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    asm volatile("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t value;
+    asm volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr3(uint32_t value) {
+    asm volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    asm volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    asm volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+// Flush one page's TLB entry
+static inline void invlpg(uint32_t addr) {
+    asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+// Index of the highest set bit (value must be non-zero)
+static inline uint32_t bsr(uint32_t value) {
+    uint32_t index;
+    asm("bsr %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+#endif // CPU_H
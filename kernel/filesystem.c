@@ -1,5 +1,7 @@
 #include "filesystem.h"
 #include "memory.h"
+#include "slab.h"
+#include "clock.h"
 
 // Inode table
 static inode_t inode_table[MAX_FILES];
@@ -8,6 +10,9 @@ static inode_t inode_table[MAX_FILES];
 static file_descriptor_t *open_files[MAX_FILES];
 static uint32_t open_file_count = 0;
 
+// Object cache for file descriptors
+static kmem_cache_t *fd_cache = NULL;
+
 // Filesystem state
 static uint32_t next_inode_num = 1;
 static uint32_t inode_count = 0;
@@ -29,10 +34,15 @@ void filesystem_init(void) {
         inode_table[i].inode_num = i;
         inode_table[i].size = 0;
         inode_table[i].capacity = MAX_FILE_SIZE;
-        inode_table[i].data = NULL;
+        inode_table[i].allocated = 0;
+        inode_table[i].data = 0;
         inode_table[i].filename[0] = '\0';
         open_files[i] = NULL;
     }
+    
+    if (!fd_cache) {
+        fd_cache = kmem_cache_create("file_descriptor_t", sizeof(file_descriptor_t), 0, NULL);
+    }
 }
 
 // Find inode by filename
@@ -100,8 +110,9 @@ int32_t fs_open(const char *filename, file_mode_t mode, uint32_t pid) {
             inode->inode_num = next_inode_num++;
             inode->size = 0;
             inode->capacity = MAX_FILE_SIZE;
-            inode->created_ticks = 0;
-            inode->modified_ticks = 0;
+            inode->allocated = 0;
+            inode->created_ns = clock_monotonic_ns();
+            inode->modified_ns = inode->created_ns;
             
             // Copy filename (with bounds checking)
             const char *src = filename;
@@ -117,15 +128,16 @@ int32_t fs_open(const char *filename, file_mode_t mode, uint32_t pid) {
         } else if (mode == FILE_MODE_WRITE) {
             // Clear existing file in write mode
             if (inode->data) {
-                free(inode->data);
+                hfree(inode->data);
             }
-            inode->data = NULL;
+            inode->data = 0;
+            inode->allocated = 0;
             inode->size = 0;
         }
     }
     
     // Allocate file descriptor
-    fd = (file_descriptor_t *)malloc(sizeof(file_descriptor_t));
+    fd = (file_descriptor_t *)kmem_cache_alloc(fd_cache);
     if (!fd) {
         return -1;  // Out of memory
     }
@@ -134,6 +146,7 @@ int32_t fs_open(const char *filename, file_mode_t mode, uint32_t pid) {
     fd->inode_num = inode->inode_num;
     fd->size = inode->size;
     fd->capacity = inode->capacity;
+    fd->allocated = inode->allocated;
     fd->state = FILE_STATE_OPEN;
     fd->owner_pid = pid;
     fd->read_pos = 0;
@@ -170,10 +183,11 @@ int fs_close(int32_t fd) {
         inode->size = open_files[fd]->size;
         inode->data = open_files[fd]->data;
         inode->capacity = open_files[fd]->capacity;
-        inode->modified_ticks = 0;
+        inode->allocated = open_files[fd]->allocated;
+        inode->modified_ns = clock_monotonic_ns();
     }
     
-    free(open_files[fd]);
+    kmem_cache_free(fd_cache, open_files[fd]);
     open_files[fd] = NULL;
     
     // Shift remaining open files
@@ -211,11 +225,10 @@ int fs_read(int32_t fd, uint8_t *buffer, uint32_t size) {
         return -1;  // Buffer bounds exceeded
     }
     
-    // Copy data
-    uint8_t *src = file->data + file->read_pos;
-    for (uint32_t i = 0; i < to_read; i++) {
-        buffer[i] = src[i];
-    }
+    // Copy data (pinned so the compactor cannot move it meanwhile)
+    uint8_t *file_data = (uint8_t *)hlock(file->data);
+    memcpy(buffer, file_data + file->read_pos, to_read);
+    hunlock(file->data);
     
     file->read_pos += to_read;
     return to_read;
@@ -234,45 +247,54 @@ int fs_write(int32_t fd, const uint8_t *data, uint32_t size) {
         return -1;  // Would exceed capacity
     }
     
+    // Bounds check on input data, before the file is touched
+    if (size > 0 && !memory_check_bounds((void *)data, size - 1)) {
+        return -1;  // Input buffer bounds exceeded
+    }
+    
     // Check if we need more space
     uint32_t needed_size = file->write_pos + size;
     
-    if (needed_size > file->size) {
-        // Allocate more space
-        uint8_t *new_data = (uint8_t *)malloc(needed_size + 1);  // +1 for null terminator
-        if (!new_data) {
-            return -1;  // Out of memory
+    if (needed_size + 1 > file->allocated) {  // +1 for null terminator
+        // Grow geometrically so appends stay amortized O(1)
+        uint32_t new_alloc = file->allocated ? file->allocated * 2 : FILE_MIN_ALLOC;
+        if (new_alloc < needed_size + 1) {
+            new_alloc = needed_size + 1;
+        }
+        if (new_alloc > file->capacity + 1) {
+            new_alloc = file->capacity + 1;
         }
         
-        // Copy old data
-        if (file->data && file->size > 0) {
-            for (uint32_t i = 0; i < file->size; i++) {
-                new_data[i] = file->data[i];
+        // File data is relocatable so the compactor can defragment the heap
+        if (file->data) {
+            if (!hrealloc(file->data, new_alloc)) {
+                return -1;  // Out of memory
+            }
+        } else {
+            file->data = halloc(new_alloc);
+            if (!file->data) {
+                return -1;  // Out of memory
             }
-            free(file->data);
         }
         
-        file->data = new_data;
-        file->size = needed_size;
+        file->allocated = new_alloc;
     }
     
-    // Bounds check on input data
-    if (!memory_check_bounds((void *)data, size - 1)) {
-        return -1;  // Input buffer bounds exceeded
+    if (needed_size > file->size) {
+        file->size = needed_size;
     }
     
     // Write data
-    uint8_t *dst = file->data + file->write_pos;
-    for (uint32_t i = 0; i < size; i++) {
-        dst[i] = data[i];
-    }
+    uint8_t *file_data = (uint8_t *)hlock(file->data);
+    memcpy(file_data + file->write_pos, data, size);
     
     file->write_pos += size;
     
     // Add null terminator if this is text data
-    if (file->data && file->write_pos < file->capacity) {
-        file->data[file->write_pos] = '\0';
+    if (file_data && file->write_pos < file->allocated) {
+        file_data[file->write_pos] = '\0';
     }
+    hunlock(file->data);
     
     return size;
 }
@@ -293,14 +315,15 @@ int fs_delete(const char *filename) {
     
     // Free file data
     if (inode->data) {
-        free(inode->data);
+        hfree(inode->data);
     }
     
     // Mark inode as unused
     inode->is_used = 0;
     inode->size = 0;
     inode->capacity = MAX_FILE_SIZE;
-    inode->data = NULL;
+    inode->allocated = 0;
+    inode->data = 0;
     inode_count--;
     
     return 0;
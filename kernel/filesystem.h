@@ -3,12 +3,14 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "memory.h"
 
 // Filesystem constants
 #define MAX_FILES 32
 #define MAX_FILENAME 64
 #define MAX_FILE_SIZE 65536     // 64KB max file size
 #define INODE_SIZE 256          // Size of inode metadata
+#define FILE_MIN_ALLOC 64       // Smallest data buffer handed to a file
 
 // File modes
 typedef enum {
@@ -29,11 +31,12 @@ typedef struct {
     char filename[MAX_FILENAME];  // File name
     uint32_t size;              // Current size (used bytes)
     uint32_t capacity;          // Maximum capacity
-    uint32_t created_ticks;     // Creation time
-    uint32_t modified_ticks;    // Modification time
+    uint32_t allocated;         // Bytes allocated for data (grows geometrically)
+    uint64_t created_ns;        // Creation time (clock_monotonic_ns)
+    uint64_t modified_ns;       // Last modification time
     file_state_t state;         // File state
     uint32_t owner_pid;         // Owner process ID
-    uint8_t *data;              // File data pointer
+    mem_handle_t data;          // File data (relocatable, 0 if none)
     uint32_t read_pos;          // Current read position
     uint32_t write_pos;         // Current write position
 } file_descriptor_t;
@@ -44,9 +47,10 @@ typedef struct {
     char filename[MAX_FILENAME];  // File name
     uint32_t size;              // Current size (used bytes)
     uint32_t capacity;          // Maximum capacity
-    uint32_t created_ticks;     // Creation time
-    uint32_t modified_ticks;    // Modification time
-    uint8_t *data;              // Pointer to file data
+    uint32_t allocated;         // Bytes allocated for data (grows geometrically)
+    uint64_t created_ns;        // Creation time (clock_monotonic_ns)
+    uint64_t modified_ns;       // Last modification time
+    mem_handle_t data;          // File data (relocatable, 0 if none)
     uint8_t is_used;            // 1 if inode is in use
 } inode_t;
 
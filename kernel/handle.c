@@ -0,0 +1,113 @@
+#include "handle.h"
+#include "memory.h"
+
+// Slot by index (index < capacity)
+static handle_slot_t *handle_slot(const handle_table_t *table, uint32_t index) {
+    return &table->chunks[index / HANDLE_CHUNK_SLOTS][index % HANDLE_CHUNK_SLOTS];
+}
+
+void handle_table_init(handle_table_t *table, uint32_t limit) {
+    for (uint32_t i = 0; i < HANDLE_MAX_CHUNKS; i++) {
+        table->chunks[i] = NULL;
+    }
+    table->capacity = 0;
+    table->limit = (limit > HANDLE_MAX_SLOTS) ? HANDLE_MAX_SLOTS : limit;
+    table->count = 0;
+    table->free_head = HANDLE_NONE;
+    spin_init(&table->lock);
+}
+
+// Append a chunk of free slots (table locked). The slots are linked in
+// before capacity covers them, so a reader never sees a slot half set up.
+static void handle_add_chunk(handle_table_t *table, handle_slot_t *chunk) {
+    uint32_t base = table->capacity;
+    uint32_t slots = table->limit - base;
+    if (slots > HANDLE_CHUNK_SLOTS) {
+        slots = HANDLE_CHUNK_SLOTS;
+    }
+    
+    // Lowest index first off the free list
+    for (uint32_t i = 0; i < slots; i++) {
+        chunk[i].object = NULL;
+        chunk[i].generation = 0;
+        chunk[i].next_free = (i + 1 < slots) ? base + i + 1 : table->free_head;
+    }
+    table->chunks[base / HANDLE_CHUNK_SLOTS] = chunk;
+    table->free_head = base;
+    asm volatile("" : : : "memory");
+    table->capacity = base + slots;
+}
+
+// The heap is not called with the lock held: a new chunk is allocated
+// unlocked and dropped again if another CPU grew the table meanwhile
+uint32_t handle_alloc(handle_table_t *table, void *object) {
+    if (!object) {
+        return 0;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&table->lock);
+    while (table->free_head == HANDLE_NONE) {
+        uint32_t capacity = table->capacity;
+        spin_unlock_irqrestore(&table->lock, flags);
+        if (capacity >= table->limit) {
+            return 0;  // Table full
+        }
+        
+        handle_slot_t *chunk = (handle_slot_t *)malloc(HANDLE_CHUNK_SLOTS * sizeof(handle_slot_t));
+        if (!chunk) {
+            return 0;  // Out of memory
+        }
+        
+        flags = spin_lock_irqsave(&table->lock);
+        if (table->capacity == capacity) {
+            handle_add_chunk(table, chunk);
+        } else {
+            spin_unlock_irqrestore(&table->lock, flags);
+            free(chunk);
+            flags = spin_lock_irqsave(&table->lock);
+        }
+    }
+    
+    uint32_t index = table->free_head;
+    handle_slot_t *slot = handle_slot(table, index);
+    table->free_head = slot->next_free;
+    table->count++;
+    slot->object = object;
+    uint32_t handle = (slot->generation << HANDLE_INDEX_BITS) | (index + 1);
+    spin_unlock_irqrestore(&table->lock, flags);
+    
+    return handle;
+}
+
+// The object is cleared before the generation moves on; handle_lookup()
+// reads them the other way round, so it cannot pair a new owner with an
+// old handle
+void handle_free(handle_table_t *table, uint32_t handle) {
+    uint32_t flags = spin_lock_irqsave(&table->lock);
+    if (handle_lookup(table, handle)) {
+        uint32_t index = (handle & HANDLE_INDEX_MASK) - 1;
+        handle_slot_t *slot = handle_slot(table, index);
+        slot->object = NULL;
+        asm volatile("" : : : "memory");
+        slot->generation = (slot->generation + 1) & HANDLE_GENERATION_MASK;
+        slot->next_free = table->free_head;
+        table->free_head = index;
+        table->count--;
+    }
+    spin_unlock_irqrestore(&table->lock, flags);
+}
+
+void *handle_lookup(handle_table_t *table, uint32_t handle) {
+    uint32_t index = (handle & HANDLE_INDEX_MASK) - 1;
+    if (index >= table->capacity) {
+        return NULL;  // Handle 0, or a slot that was never allocated
+    }
+    
+    handle_slot_t *slot = handle_slot(table, index);
+    void *object = slot->object;
+    asm volatile("" : : : "memory");
+    if (slot->generation != (handle >> HANDLE_INDEX_BITS)) {
+        return NULL;
+    }
+    return object;
+}
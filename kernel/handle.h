@@ -0,0 +1,63 @@
+#ifndef HANDLE_H
+#define HANDLE_H
+
+#include <stdint.h>
+#include "spinlock.h"
+
+// A handle is (generation << HANDLE_INDEX_BITS) | (slot + 1): the slot
+// gives O(1) lookup and the generation, bumped whenever a slot is freed,
+// makes a stale handle miss instead of finding the slot's next owner.
+// The first owner of each slot gets generation 0, so the first handles
+// handed out are simply 1, 2, 3, ... and 0 is never a valid handle.
+#define HANDLE_INDEX_BITS 12
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK 0x7FFFF     // Keeps handles positive as ints
+#define HANDLE_MAX_SLOTS HANDLE_INDEX_MASK  // Slot + 1 must fit the index bits
+
+// Slots are allocated in chunks as the table grows. Chunks never move
+// or go away, so readers need no lock.
+#define HANDLE_CHUNK_SLOTS 64
+#define HANDLE_MAX_CHUNKS ((HANDLE_MAX_SLOTS + HANDLE_CHUNK_SLOTS - 1) / HANDLE_CHUNK_SLOTS)
+
+#define HANDLE_NONE 0xFFFFFFFF            // End of the free list
+
+typedef struct {
+    void *volatile object;             // NULL while free
+    volatile uint32_t generation;      // Generation of the current/next owner
+    uint32_t next_free;                // Next free slot (while free)
+} handle_slot_t;
+
+// Handle table; zero it or call handle_table_init() before use
+typedef struct {
+    handle_slot_t *chunks[HANDLE_MAX_CHUNKS];
+    volatile uint32_t capacity;        // Slots in the chunks allocated so far
+    uint32_t limit;                    // Slots it may grow to
+    uint32_t count;                    // Handles in use
+    uint32_t free_head;                // Most recently freed slot first
+    spinlock_t lock;                   // Serializes alloc and free
+} handle_table_t;
+
+// Empty table that grows to at most limit slots (capped at HANDLE_MAX_SLOTS)
+void handle_table_init(handle_table_t *table, uint32_t limit);
+
+// Give object a handle; 0 when the table is full or out of memory.
+// Freed slots are reused before the table grows.
+uint32_t handle_alloc(handle_table_t *table, void *object);
+
+// Retire a handle; lookups of it fail from now on
+void handle_free(handle_table_t *table, uint32_t handle);
+
+// Object behind a handle, or NULL if it is stale or was never handed out
+void *handle_lookup(handle_table_t *table, uint32_t handle);
+
+// Iteration: objects by slot, NULL for free slots. Slot order is not
+// creation order once slots are reused.
+static inline uint32_t handle_capacity(const handle_table_t *table) {
+    return table->capacity;
+}
+
+static inline void *handle_at(const handle_table_t *table, uint32_t slot) {
+    return table->chunks[slot / HANDLE_CHUNK_SLOTS][slot % HANDLE_CHUNK_SLOTS].object;
+}
+
+#endif // HANDLE_H
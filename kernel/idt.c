@@ -1,7 +1,14 @@
 #include "idt.h"
+#include "apic.h"
 
 extern void isr_keyboard(void);
 extern void isr_timer(void);
+extern void isr_page_fault(void);
+extern void isr_yield(void);
+extern void isr_lapic_timer(void);
+extern void isr_resched(void);
+extern void isr_tlb(void);
+extern void isr_spurious(void);
 extern void isr_stub(void);  // Default handler for all interrupts
 
 static struct idt_entry idt[256];
@@ -23,11 +30,28 @@ void idt_init(void) {
     for (int i = 0; i < 256; i++)
         idt_set_gate(i, (uint32_t)isr_stub);
 
+    // Page fault → 14 (demand-zero paging)
+    idt_set_gate(14, (uint32_t)isr_page_fault);
+
     // Timer IRQ0 → 0x20 (PIC remap után)
     idt_set_gate(0x20, (uint32_t)isr_timer);
     
     // Keyboard IRQ1 → 0x21 (PIC remap után)
     idt_set_gate(0x21, (uint32_t)isr_keyboard);
+    
+    // Yield → 0x30 (thread_yield, YIELD_VECTOR in process.h)
+    idt_set_gate(0x30, (uint32_t)isr_yield);
+    
+    // SMP IPIs and the AP timer (vectors in apic.h)
+    idt_set_gate(RESCHED_VECTOR, (uint32_t)isr_resched);
+    idt_set_gate(TLB_VECTOR, (uint32_t)isr_tlb);
+    idt_set_gate(APIC_TIMER_VECTOR, (uint32_t)isr_lapic_timer);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)isr_spurious);
+    
+    idt_load();
+}
 
+// Load the shared IDT on the executing CPU
+void idt_load(void) {
     asm volatile("lidt %0" : : "m"(idtp));
 }
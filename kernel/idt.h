@@ -15,3 +15,4 @@ struct idt_ptr {
 } __attribute__((packed));
 
 void idt_init(void);
+void idt_load(void);
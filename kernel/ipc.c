@@ -1,5 +1,9 @@
 #include "ipc.h"
 #include "memory.h"
+#include "slab.h"
+#include "clock.h"
+#include "waitqueue.h"
+#include "spinlock.h"
 
 // Message queue table
 static ipc_queue_t queue_table[MAX_MESSAGE_QUEUES];
@@ -9,6 +13,14 @@ static uint32_t next_queue_id = 1;
 // IPC statistics
 static ipc_stats_t ipc_stats = {0};
 
+// Guards the queue table, the rings and the statistics. A receiver takes
+// its queue's receivers.lock before dropping this one to sleep, so a
+// send in between still finds it on the wait queue.
+static spinlock_t ipc_lock = SPINLOCK_INIT;
+
+// Object cache for in-flight messages
+static kmem_cache_t *message_cache = NULL;
+
 // External function declarations
 void console_puts(const char *s);
 void itoa(int num, char *str);
@@ -26,6 +38,7 @@ void ipc_init(void) {
         queue_table[i].head = 0;
         queue_table[i].tail = 0;
         queue_table[i].count = 0;
+        wait_queue_init(&queue_table[i].receivers);
     }
     
     ipc_stats.total_queues = MAX_MESSAGE_QUEUES;
@@ -33,11 +46,17 @@ void ipc_init(void) {
     ipc_stats.total_messages = 0;
     ipc_stats.total_sent = 0;
     ipc_stats.total_received = 0;
+    
+    if (!message_cache) {
+        message_cache = kmem_cache_create("ipc_message_t", sizeof(ipc_message_t), 0, NULL);
+    }
 }
 
 // Create a message queue
 uint32_t ipc_create_queue(uint32_t owner_pid) {
+    uint32_t flags = spin_lock_irqsave(&ipc_lock);
     if (queue_count >= MAX_MESSAGE_QUEUES) {
+        spin_unlock_irqrestore(&ipc_lock, flags);
         return 0;  // No free queues
     }
     
@@ -54,25 +73,41 @@ uint32_t ipc_create_queue(uint32_t owner_pid) {
             queue_count++;
             ipc_stats.active_queues++;
             
-            return queue_table[i].queue_id;
+            uint32_t queue_id = queue_table[i].queue_id;
+            spin_unlock_irqrestore(&ipc_lock, flags);
+            return queue_id;
         }
     }
     
+    spin_unlock_irqrestore(&ipc_lock, flags);
     return 0;
 }
 
 // Destroy a message queue
 int ipc_destroy_queue(uint32_t queue_id) {
+    uint32_t flags = spin_lock_irqsave(&ipc_lock);
     for (uint32_t i = 0; i < MAX_MESSAGE_QUEUES; i++) {
         if (queue_table[i].is_used && queue_table[i].queue_id == queue_id) {
+            // Release messages nobody received
+            while (queue_table[i].count > 0) {
+                kmem_cache_free(message_cache, queue_table[i].messages[queue_table[i].head]);
+                queue_table[i].head = (queue_table[i].head + 1) % MAX_MESSAGES_PER_QUEUE;
+                queue_table[i].count--;
+            }
+            
             queue_table[i].is_used = 0;
             queue_table[i].count = 0;
             queue_count--;
+            
+            // Blocked receivers find the queue gone and fail
+            wake_all(&queue_table[i].receivers);
             ipc_stats.active_queues--;
+            spin_unlock_irqrestore(&ipc_lock, flags);
             return 0;
         }
     }
     
+    spin_unlock_irqrestore(&ipc_lock, flags);
     return -1;  // Queue not found
 }
 
@@ -82,6 +117,21 @@ int ipc_send_message(uint32_t from_pid, uint32_t to_pid, const uint8_t *data, ui
         return -1;  // Invalid message
     }
     
+    // Build the message before taking the lock
+    ipc_message_t *msg = (ipc_message_t *)kmem_cache_alloc(message_cache);
+    if (!msg) {
+        return -1;  // Out of memory
+    }
+    msg->from_pid = from_pid;
+    msg->to_pid = to_pid;
+    msg->timestamp = clock_monotonic_ns();
+    msg->size = size;
+    
+    // Copy data
+    memcpy(msg->data, data, size);
+    
+    uint32_t flags = spin_lock_irqsave(&ipc_lock);
+    
     // Find receiver's queue
     ipc_queue_t *queue = NULL;
     for (uint32_t i = 0; i < MAX_MESSAGE_QUEUES; i++) {
@@ -91,60 +141,94 @@ int ipc_send_message(uint32_t from_pid, uint32_t to_pid, const uint8_t *data, ui
         }
     }
     
-    if (!queue) {
-        return -1;  // Receiver queue not found
-    }
-    
-    // Check if queue is full
-    if (queue->count >= MAX_MESSAGES_PER_QUEUE) {
-        return -1;  // Queue full
-    }
-    
-    // Add message to queue
-    ipc_message_t *msg = &queue->messages[queue->tail];
-    msg->from_pid = from_pid;
-    msg->to_pid = to_pid;
-    msg->timestamp = 0;  // TODO: use actual tick count
-    msg->size = size;
-    
-    // Copy data
-    for (uint32_t i = 0; i < size; i++) {
-        msg->data[i] = data[i];
+    // Receiver queue not found, or full
+    if (!queue || queue->count >= MAX_MESSAGES_PER_QUEUE) {
+        spin_unlock_irqrestore(&ipc_lock, flags);
+        kmem_cache_free(message_cache, msg);
+        return -1;
     }
     
+    // Publish and wake a blocked receiver in one step, so it cannot
+    // check the queue in between
+    queue->messages[queue->tail] = msg;
     queue->tail = (queue->tail + 1) % MAX_MESSAGES_PER_QUEUE;
     queue->count++;
     ipc_stats.total_sent++;
     ipc_stats.total_messages++;
+    wake_one(&queue->receivers);
+    spin_unlock_irqrestore(&ipc_lock, flags);
     
     return 0;
 }
 
 // Receive a message
 int ipc_receive_message(uint32_t to_pid, ipc_message_t *msg) {
+    return ipc_receive_message_timeout(to_pid, msg, 0);
+}
+
+// Receive a message, sleeping until one arrives or timeout_ms passes.
+// The queue is looked up again after every wakeup since it may have
+// been destroyed meanwhile.
+int ipc_receive_message_timeout(uint32_t to_pid, ipc_message_t *msg, uint32_t timeout_ms) {
     if (!msg) {
         return -1;
     }
     
-    // Find receiver's queue
-    ipc_queue_t *queue = NULL;
-    for (uint32_t i = 0; i < MAX_MESSAGE_QUEUES; i++) {
-        if (queue_table[i].is_used && queue_table[i].owner_pid == to_pid) {
-            queue = &queue_table[i];
+    uint32_t deadline = scheduler_get_ticks() + timer_ms_to_ticks(timeout_ms);
+    ipc_message_t *pending = NULL;
+    
+    uint32_t flags = spin_lock_irqsave(&ipc_lock);
+    while (1) {
+        // Find receiver's queue
+        ipc_queue_t *queue = NULL;
+        for (uint32_t i = 0; i < MAX_MESSAGE_QUEUES; i++) {
+            if (queue_table[i].is_used && queue_table[i].owner_pid == to_pid) {
+                queue = &queue_table[i];
+                break;
+            }
+        }
+        
+        if (!queue) {
+            break;  // No queue
+        }
+        
+        if (queue->count > 0) {
+            // Get message from queue
+            pending = queue->messages[queue->head];
+            queue->head = (queue->head + 1) % MAX_MESSAGES_PER_QUEUE;
+            queue->count--;
+            ipc_stats.total_received++;
             break;
         }
+        
+        if (timeout_ms == 0) {
+            break;  // Polling receive
+        }
+        
+        // Queue up as a receiver before letting senders in
+        spin_lock(&queue->receivers.lock);
+        spin_unlock(&ipc_lock);
+        int woken = 1;
+        if (timeout_ms == IPC_WAIT_FOREVER) {
+            wait_queue_sleep(&queue->receivers);
+        } else {
+            woken = wait_queue_sleep_until(&queue->receivers, deadline);
+        }
+        spin_unlock(&queue->receivers.lock);
+        spin_lock(&ipc_lock);
+        
+        if (!woken) {
+            timeout_ms = 0;  // One last look, then give up
+        }
     }
+    spin_unlock_irqrestore(&ipc_lock, flags);
     
-    if (!queue || queue->count == 0) {
+    if (!pending) {
         return -1;  // No messages
     }
     
-    // Get message from queue
-    *msg = queue->messages[queue->head];
-    queue->head = (queue->head + 1) % MAX_MESSAGES_PER_QUEUE;
-    queue->count--;
-    ipc_stats.total_received++;
-    
+    *msg = *pending;
+    kmem_cache_free(message_cache, pending);
     return 0;
 }
 
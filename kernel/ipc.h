@@ -3,17 +3,19 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "waitqueue.h"
 
 // IPC message queue constants
 #define MAX_MESSAGE_QUEUES 8
 #define MAX_MESSAGES_PER_QUEUE 32
 #define MAX_MESSAGE_SIZE 256
+#define IPC_WAIT_FOREVER 0xFFFFFFFF  // Receive timeout that never expires
 
 // Message structure
 typedef struct {
     uint32_t from_pid;          // Sender process ID
     uint32_t to_pid;            // Receiver process ID
-    uint32_t timestamp;         // Message timestamp
+    uint64_t timestamp;         // Send time in ns (clock_monotonic_ns)
     uint32_t size;              // Message size
     uint8_t data[MAX_MESSAGE_SIZE];  // Message data
 } ipc_message_t;
@@ -22,10 +24,11 @@ typedef struct {
 typedef struct {
     uint32_t queue_id;          // Queue ID
     uint32_t owner_pid;         // Owner process ID
-    ipc_message_t messages[MAX_MESSAGES_PER_QUEUE];  // Message buffer
+    ipc_message_t *messages[MAX_MESSAGES_PER_QUEUE];  // Pending messages (slab objects)
     uint32_t head;              // Head index
     uint32_t tail;              // Tail index
     uint32_t count;             // Message count
+    wait_queue_t receivers;     // Threads blocked in receive
     uint8_t is_used;            // 1 if queue is active
 } ipc_queue_t;
 
@@ -46,6 +49,10 @@ uint32_t ipc_create_queue(uint32_t owner_pid);
 int ipc_destroy_queue(uint32_t queue_id);
 int ipc_send_message(uint32_t from_pid, uint32_t to_pid, const uint8_t *data, uint32_t size);
 int ipc_receive_message(uint32_t to_pid, ipc_message_t *msg);
+
+// Receive, blocking up to timeout_ms (0 polls, IPC_WAIT_FOREVER never
+// times out); returns -1 if the queue is missing or nothing arrived
+int ipc_receive_message_timeout(uint32_t to_pid, ipc_message_t *msg, uint32_t timeout_ms);
 int ipc_queue_exists(uint32_t queue_id);
 
 // Statistics
@@ -3,23 +3,47 @@ BITS 32
 GLOBAL isr_stub
 GLOBAL isr_keyboard
 GLOBAL isr_timer
+GLOBAL isr_page_fault
+GLOBAL isr_yield
+GLOBAL isr_lapic_timer
+GLOBAL isr_resched
+GLOBAL isr_tlb
+GLOBAL isr_spurious
 EXTERN keyboard_handler
+EXTERN page_fault_handler
 EXTERN scheduler_schedule
+EXTERN scheduler_schedule_local
+EXTERN process_yield_switch
+EXTERN process_preempt_switch
+EXTERN process_finish_switch
+EXTERN smp_tlb_handler
+EXTERN irq_eoi
+
+; GS always selects the executing CPU's cpu_t (smp.h), so handlers leave
+; it alone. The switching handlers keep a gs slot in thread_frame_t but
+; skip it on the way out: a thread may resume on a different CPU.
+; Every handler that calls C clears the direction flag first: an
+; interrupt can land inside a backward string copy (memmove) with DF set.
 
 isr_stub:
     pusha
+    cld
     
-    ; Send EOI to PIC
-    mov al, 0x20
-    out 0x20, al
+    ; Acknowledge at the LAPIC (or the 8259 before apic_init)
+    call irq_eoi
     
     popa
     iretd
 
+isr_spurious:
+    ; Spurious LAPIC interrupts must not be acknowledged
+    iretd
+
 isr_keyboard:
     cli
 
     pusha
+    cld
 
     push ds
     push es
@@ -30,33 +54,168 @@ isr_keyboard:
     mov ds, ax
     mov es, ax
     mov fs, ax
-    mov gs, ax
 
     call keyboard_handler
 
+    ; Acknowledge at the LAPIC (or the 8259 before apic_init)
+    call irq_eoi
+
     pop gs
     pop fs
     pop es
     pop ds
 
-    ; Send EOI to PIC (master controller)
-    mov al, 0x20
-    out 0x20, al
-
     popa
     
     ; Don't use sti here - let iretd restore IF flag from stack
     iretd
 
 isr_timer:
-    cli
+    ; Save the full frame on the interrupted thread's stack (thread_frame_t)
+    pusha
+    cld
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10        ; kernel data segment selector
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+
+    ; Acknowledge before we possibly switch away
+    call irq_eoi
+
+    ; scheduler_schedule(frame) returns the frame of the thread to resume
+    push esp
+    call scheduler_schedule
+    mov esp, eax
+
+    ; Off the old thread's stack: it may be requeued now
+    call process_finish_switch
+
+    add esp, 4          ; gs stays on this CPU's block
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    
+    ; iretd restores the resumed thread's IF
+    iretd
+
+isr_page_fault:
+    ; CPU pushed an error code above the return eip
     pusha
+    cld
     
-    ; Send EOI to PIC
-    mov al, 0x20
-    out 0x20, al
+    push dword [esp + 36]   ; faulting eip
+    push dword [esp + 36]   ; error code (shifted by the first push)
+    call page_fault_handler
+    add esp, 8
     
     popa
-    
-    sti
+    add esp, 4              ; drop error code
+    iretd
+
+isr_yield:
+    ; Voluntary switch (thread_yield): same frame as isr_timer, no EOI
+    pusha
+    cld
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10        ; kernel data segment selector
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+
+    push esp
+    call process_yield_switch
+    mov esp, eax
+
+    call process_finish_switch
+
+    add esp, 4          ; gs stays on this CPU's block
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    iretd
+
+isr_lapic_timer:
+    ; LAPIC timer on an application processor: like isr_timer, but the
+    ; global tick count and the timer wheel belong to the boot CPU
+    pusha
+    cld
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10        ; kernel data segment selector
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+
+    call irq_eoi
+
+    push esp
+    call scheduler_schedule_local
+    mov esp, eax
+
+    call process_finish_switch
+
+    add esp, 4          ; gs stays on this CPU's block
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    iretd
+
+isr_resched:
+    ; Reschedule IPI: a thread that should preempt this CPU's became ready
+    pusha
+    cld
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10        ; kernel data segment selector
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+
+    call irq_eoi
+
+    push esp
+    call process_preempt_switch
+    mov esp, eax
+
+    call process_finish_switch
+
+    add esp, 4          ; gs stays on this CPU's block
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    iretd
+
+isr_tlb:
+    ; TLB shootdown IPI (smp_tlb_handler sends the EOI)
+    pusha
+    cld
+    call smp_tlb_handler
+    popa
     iretd
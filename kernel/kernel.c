@@ -3,14 +3,23 @@
 #include "pic.h"
 #include "scheduler.h"
 #include "keyboard.h"
+#include "multiboot.h"
 #include "memory.h"
+#include "page.h"
+#include "slab.h"
+#include "paging.h"
 #include "process.h"
 #include "filesystem.h"
 #include "ipc.h"
 #include "logging.h"
+#include "clock.h"
+#include "timer.h"
+#include "smp.h"
+#include "apic.h"
 
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
+#define TOP_REFRESH_MS 1000
 
 static volatile uint8_t *vga = (uint8_t*)0xB8000;
 static volatile int cursor_x = 0;
@@ -167,6 +176,17 @@ void itoa(int num, char *str) {
     }
 }
 
+void itoa_hex(uint32_t num, char *str) {
+    const char *digits = "0123456789ABCDEF";
+    
+    str[0] = '0';
+    str[1] = 'x';
+    for (int i = 0; i < 8; i++) {
+        str[2 + i] = digits[(num >> (28 - i * 4)) & 0xF];
+    }
+    str[10] = '\0';
+}
+
 int evaluate_math(const char *expr, int *result) {
     // Parse simple math expressions like "2+3" or "10*5" or "20/4"
     int left = 0;
@@ -212,6 +232,70 @@ int evaluate_math(const char *expr, int *result) {
     return 1;
 }
 
+// Copy the value of key=value from a space-separated command line;
+// returns 0 if the key is not there
+static int cmdline_option(const char *cmdline, const char *key, char *value, int size) {
+    int key_len = 0;
+    while (key[key_len]) {
+        key_len++;
+    }
+    
+    while (cmdline && *cmdline) {
+        if (strncmp(cmdline, key, key_len) == 0 && cmdline[key_len] == '=') {
+            const char *src = &cmdline[key_len + 1];
+            int i = 0;
+            while (src[i] && src[i] != ' ' && i < size - 1) {
+                value[i] = src[i];
+                i++;
+            }
+            value[i] = '\0';
+            return 1;
+        }
+        
+        // Next word
+        while (*cmdline && *cmdline != ' ') {
+            cmdline++;
+        }
+        while (*cmdline == ' ') {
+            cmdline++;
+        }
+    }
+    return 0;
+}
+
+// Demo process body for /spawn: count forever in the process's own
+// demand-zero memory so preemption and per-process paging are visible
+static void spawn_counter_main(void) {
+    volatile uint32_t *counter = (volatile uint32_t *)USER_SPACE_BASE;
+    while (1) {
+        (*counter)++;
+    }
+}
+
+// Demo process body for /rtspawn: each job busies the CPU for half the
+// thread's runtime, then waits for the next period
+static void rt_demo_main(void) {
+    uint64_t work_ns = (uint64_t)process_current_thread()->edf.params.runtime_ms * 500000;
+    while (1) {
+        uint64_t start = clock_monotonic_ns();
+        while (clock_monotonic_ns() - start < work_ns) {
+            cpu_relax();
+        }
+        thread_wait_period();
+    }
+}
+
+// Skip to the argument after the current one
+static const char *next_arg(const char *str) {
+    while (*str && *str != ' ') {
+        str++;
+    }
+    while (*str == ' ') {
+        str++;
+    }
+    return str;
+}
+
 void process_command(const char *input) {
     char buffer[64];
     
@@ -251,6 +335,37 @@ void process_command(const char *input) {
     
     if (strcmp(input, "/memstat") == 0) {
         memory_print_stats();
+        paging_print_stats();
+        return;
+    }
+    
+    if (strcmp(input, "/heapmap") == 0) {
+        memory_print_heapmap();
+        return;
+    }
+    
+    if (strcmp(input, "/leaks") == 0) {
+        memory_print_leaks();
+        return;
+    }
+    
+    if (strcmp(input, "/membench") == 0) {
+        memops_benchmark();
+        return;
+    }
+    
+    if (strcmp(input, "/pagestat") == 0) {
+        page_print_stats();
+        return;
+    }
+    
+    if (strcmp(input, "/slabstat") == 0) {
+        kmem_print_stats();
+        return;
+    }
+    
+    if (strcmp(input, "/kmembench") == 0) {
+        kmem_benchmark();
         return;
     }
     
@@ -264,6 +379,107 @@ void process_command(const char *input) {
         return;
     }
     
+    if (strncmp(input, "/fork ", 6) == 0) {
+        uint32_t child = process_fork(atoi(&input[6]));
+        if (child) {
+            console_puts("Forked process ");
+            itoa(child, buffer);
+            console_puts(buffer);
+            console_puts("\n");
+        } else {
+            console_puts("Error: Could not fork process\n");
+        }
+        return;
+    }
+    
+    if (strcmp(input, "/clock") == 0) {
+        console_puts("Uptime: ");
+        clock_print_timestamp(clock_monotonic_ns());
+        console_puts("s\nTSC: ");
+        if (clock_tsc_khz()) {
+            itoa(clock_tsc_khz(), buffer);
+            console_puts(buffer);
+            console_puts(" kHz\n");
+        } else {
+            console_puts("not available (100Hz tick clock)\n");
+        }
+        return;
+    }
+    
+    if (strncmp(input, "/sleep ", 7) == 0) {
+        uint64_t start = clock_monotonic_ns();
+        thread_sleep_ms(atoi(&input[7]));
+        console_puts("Slept ");
+        clock_print_timestamp(clock_monotonic_ns() - start);
+        console_puts("s\n");
+        return;
+    }
+    
+    if (strcmp(input, "/timers") == 0) {
+        timer_print_stats();
+        timer_benchmark();
+        return;
+    }
+    
+    if (strcmp(input, "/schedbench") == 0) {
+        process_sched_benchmark();
+        return;
+    }
+    
+    if (strcmp(input, "/smpbench") == 0) {
+        smp_benchmark();
+        return;
+    }
+    
+    if (strcmp(input, "/spawn") == 0) {
+        uint32_t pid = process_create(spawn_counter_main, 65536, "counter");
+        if (pid) {
+            console_puts("Spawned process ");
+            itoa(pid, buffer);
+            console_puts(buffer);
+            console_puts("\n");
+        } else {
+            console_puts("Error: Could not create process\n");
+        }
+        return;
+    }
+    
+    if (strncmp(input, "/rtspawn ", 9) == 0) {
+        // Parse: /rtspawn <runtime_ms> <period_ms> [deadline_ms]
+        edf_params_t params;
+        const char *arg = &input[9];
+        params.runtime_ms = atoi(arg);
+        arg = next_arg(arg);
+        params.period_ms = atoi(arg);
+        arg = next_arg(arg);
+        params.deadline_ms = *arg ? (uint32_t)atoi(arg) : params.period_ms;
+        
+        uint32_t pid = process_create_deadline(rt_demo_main, 65536, "rt-demo", &params);
+        if (pid) {
+            console_puts("Spawned real-time process ");
+            itoa(pid, buffer);
+            console_puts(buffer);
+            console_puts("\n");
+        } else {
+            console_puts("Error: Rejected (needs 0 < runtime <= deadline <= period and free bandwidth)\n");
+        }
+        return;
+    }
+    
+    if (strcmp(input, "/rtstat") == 0) {
+        process_print_rtstat();
+        return;
+    }
+    
+    if (strncmp(input, "/kill ", 6) == 0) {
+        if (process_terminate(atoi(&input[6]))) {
+            console_puts("Process terminated\n");
+        } else {
+            console_puts("Error: Process not found\n");
+        }
+        return;
+    }
+    
     if (strncmp(input, "/procinfo ", 10) == 0) {
         const char *pid_str = &input[10];
         int pid = atoi(pid_str);
@@ -279,6 +495,29 @@ void process_command(const char *input) {
             console_puts("KB\nThreads: ");
             itoa(proc->thread_count, buffer);
             console_puts(buffer);
+            console_puts("\nCPU Ticks: ");
+            itoa(proc->total_ticks, buffer);
+            console_puts(buffer);
+            console_puts("\nCreated: ");
+            clock_print_timestamp(proc->created_ns);
+            console_puts("s");
+            if (proc->parent_pid) {
+                console_puts("\nParent: ");
+                itoa(proc->parent_pid, buffer);
+                console_puts(buffer);
+            }
+            if (proc->address_space) {
+                console_puts("\nPage Faults: ");
+                itoa(proc->address_space->page_faults, buffer);
+                console_puts(buffer);
+                console_puts("\nCOW Copies: ");
+                itoa(proc->address_space->cow_copies, buffer);
+                console_puts(buffer);
+                console_puts("\nResident: ");
+                itoa(proc->address_space->resident_pages * (PAGE_SIZE / 1024), buffer);
+                console_puts(buffer);
+                console_puts("KB");
+            }
             console_puts("\n");
         } else {
             console_puts("Process not found\n");
@@ -375,33 +614,47 @@ void process_command(const char *input) {
     }
     
     if (strcmp(input, "top") == 0) {
-        process_stats_t stats = {0};
-        process_get_stats(&stats);
-        
-        console_puts("\n=== System Processes (top) ===\n");
-        console_puts("Processes: ");
-        itoa(stats.total_processes, buffer);
-        console_puts(buffer);
-        console_puts(" | Running: ");
-        itoa(stats.running_processes, buffer);
-        console_puts(buffer);
-        console_puts(" | Ready: ");
-        itoa(stats.ready_processes, buffer);
-        console_puts(buffer);
-        console_puts("\n");
-        
-        console_puts("Threads: ");
-        itoa(stats.total_threads, buffer);
-        console_puts(buffer);
-        console_puts(" | Running: ");
-        itoa(stats.running_threads, buffer);
-        console_puts(buffer);
-        console_puts(" | Ready: ");
-        itoa(stats.ready_threads, buffer);
-        console_puts(buffer);
-        console_puts("\n");
-        
-        process_print_processes();
+        // Redraw every second until Enter; each redraw samples CPU% over
+        // the time since the previous one
+        while (1) {
+            process_stats_t stats = {0};
+            process_get_stats(&stats);
+            
+            console_clear();
+            console_puts("=== System Processes (top) ===\n");
+            console_puts("Processes: ");
+            itoa(stats.total_processes, buffer);
+            console_puts(buffer);
+            console_puts(" | Running: ");
+            itoa(stats.running_processes, buffer);
+            console_puts(buffer);
+            console_puts(" | Ready: ");
+            itoa(stats.ready_processes, buffer);
+            console_puts(buffer);
+            console_puts("\n");
+            
+            console_puts("Threads: ");
+            itoa(stats.total_threads, buffer);
+            console_puts(buffer);
+            console_puts(" | Running: ");
+            itoa(stats.running_threads, buffer);
+            console_puts(buffer);
+            console_puts(" | Ready: ");
+            itoa(stats.ready_threads, buffer);
+            console_puts(buffer);
+            console_puts("\n\n");
+            
+            process_print_top();
+            console_puts("\nPress Enter to quit\n");
+            if (keyboard_wait_line_timeout(TOP_REFRESH_MS)) {
+                break;
+            }
+        }
+        return;
+    }
+    
+    if (strcmp(input, "/schedlat") == 0) {
+        process_print_schedlat();
         return;
     }
     
@@ -426,16 +679,33 @@ void process_command(const char *input) {
         console_puts("  /pr <text>        - Echo text\n");
         console_puts("  /math <expr>      - Calculate math (e.g., /math =2+3)\n");
         console_puts("  /memstat          - Show memory statistics\n");
+        console_puts("  /heapmap          - Show map of used/free heap runs\n");
+        console_puts("  /leaks            - Show live allocations by call site\n");
+        console_puts("  /membench         - Benchmark memcpy/memset variants\n");
+        console_puts("  /pagestat         - Show page frame allocator statistics\n");
+        console_puts("  /slabstat         - Show slab cache statistics\n");
+        console_puts("  /kmembench        - Stress magazine/slab/malloc on all CPUs\n");
         console_puts("  /procstat         - Show process/thread statistics\n");
         console_puts("  /proclist         - List all processes and threads\n");
         console_puts("  /procinfo <pid>   - Show process info\n");
+        console_puts("  /clock            - Show uptime and TSC frequency\n");
+        console_puts("  /sleep <ms>       - Sleep the shell thread\n");
+        console_puts("  /timers           - Timer wheel stats and benchmark\n");
+        console_puts("  /schedbench       - Benchmark run queue/fair tree pick+requeue cost\n");
+        console_puts("  /schedlat         - Show run queue wait latency histograms\n");
+        console_puts("  /smpbench         - Time the same work on 1 and N CPUs\n");
+        console_puts("  /spawn            - Start a demo counter process\n");
+        console_puts("  /rtspawn <r> <p> [d] - Start an EDF process (runtime/period/deadline ms)\n");
+        console_puts("  /rtstat           - Show EDF bandwidth and deadline misses\n");
+        console_puts("  /fork <pid>       - Fork a process copy-on-write\n");
+        console_puts("  /kill <pid>       - Terminate a process\n");
         console_puts("  /fsstat           - Show filesystem statistics\n");
         console_puts("  /ls               - List files\n");
         console_puts("  /cat <filename>   - Read file contents\n");
         console_puts("  /write <file> <text> - Write to file\n");
         console_puts("  /rm <filename>    - Delete file\n");
         console_puts("  /proc             - View /proc filesystem\n");
-        console_puts("  top               - Show running processes\n");
+        console_puts("  top               - Live per-thread CPU usage (Enter quits)\n");
         console_puts("  dmesg             - Show all kernel logs\n");
         console_puts("  dmesg <count>     - Show last N entries\n");
         console_puts("  help              - Show this help\n");
@@ -447,17 +717,37 @@ void process_command(const char *input) {
     console_puts("\n");
 }
 
-void kernel_main(void) {
+void kernel_main(uint32_t multiboot_magic, multiboot_info_t *multiboot_info) {
+    // Per-CPU state first: everything below may ask which CPU it is on
+    smp_init();
+    
     // Initialize console
     console_clear();
     
     console_puts("=== MyOS Boot ===\n");
+    memops_init();
+    
+    console_puts("Calibrating clock...\n");
+    clock_init();
+    
     console_puts("Initializing memory...\n");
     memory_init();
     
+    console_puts("Initializing page frames...\n");
+    page_alloc_init(multiboot_magic, multiboot_info);
+    
+    console_puts("Initializing slab caches...\n");
+    kmem_init();
+    
+    console_puts("Initializing paging...\n");
+    paging_init();
+    
     console_puts("Initializing logging...\n");
     logging_init();
     log_info("Kernel initialization started");
+    if (multiboot_magic != MULTIBOOT2_BOOTLOADER_MAGIC) {
+        log_warning("No multiboot2 memory map, page allocator disabled");
+    }
     
     console_puts("Initializing filesystem...\n");
     filesystem_init();
@@ -467,7 +757,17 @@ void kernel_main(void) {
     ipc_init();
     log_info("IPC system initialized");
     
-    console_puts("Initializing process manager...\n");
+    // sched=prio|fair on the command line picks the scheduling class
+    char option[16];
+    if (multiboot_magic == MULTIBOOT2_BOOTLOADER_MAGIC &&
+        cmdline_option(multiboot_cmdline(multiboot_info), "sched", option, sizeof(option)) &&
+        process_set_sched_class(option) != 0) {
+        log_warning("Unknown sched= class, using prio");
+    }
+    
+    console_puts("Initializing process manager (");
+    console_puts(process_sched_class_name());
+    console_puts(" scheduler)...\n");
     process_manager_init();
     log_info("Process manager initialized");
     
@@ -479,10 +779,19 @@ void kernel_main(void) {
     idt_init();
     log_info("IDT initialized");
     
+    console_puts("Initializing APIC...\n");
+    if (apic_init()) {
+        log_info("Interrupts routed through the I/O APIC");
+    }
+    
     console_puts("Initializing scheduler...\n");
     scheduler_init();
     log_info("Scheduler initialized");
     
+    console_puts("Initializing timers...\n");
+    timer_init();
+    log_info("Timer wheel initialized");
+    
     console_puts("Initializing PIT...\n");
     pit_init();
     log_info("PIT initialized");
@@ -494,17 +803,21 @@ void kernel_main(void) {
     // Set keyboard callback for real-time display
     keyboard_set_display_callback(console_putchar);
     
+    console_puts("Starting application processors...\n");
+    smp_boot_aps();
+    log_info("SMP initialized");
+    
     console_puts("\nReady! Type 'help' for commands.\n");
     console_puts("> ");
     
     asm volatile("sti");
-
+    
+    // The shell sleeps until a line arrives; background memory work
+    // runs in the idle thread
     while (1) {
-        char *line = keyboard_get_line();
-        if (line) {
-            console_puts("\n");
-            process_command(line);
-            console_puts("> ");
-        }
+        char *line = keyboard_wait_line();
+        console_puts("\n");
+        process_command(line);
+        console_puts("> ");
     }
 }
@@ -1,5 +1,8 @@
 #include <stdint.h>
 #include "keyboard.h"
+#include "process.h"
+#include "waitqueue.h"
+#include "cpu.h"
 
 static inline uint8_t inb(uint16_t port) {
     uint8_t ret;
@@ -36,6 +39,7 @@ static volatile char input_buffer[INPUT_BUFFER_SIZE];
 static volatile int buffer_pos = 0;
 static volatile int input_ready = 0;
 static void (*display_callback)(char) = 0;
+static wait_queue_t line_wait = {0};  // Threads blocked in keyboard_wait_line()
 
 void keyboard_init(void) {
     buffer_pos = 0;
@@ -54,6 +58,20 @@ char* keyboard_get_line(void) {
     return 0;
 }
 
+// Block until a full line has been typed
+char* keyboard_wait_line(void) {
+    char *line;
+    wait_event(&line_wait, (line = keyboard_get_line()) != 0);
+    return line;
+}
+
+// Same, giving up after timeout_ms (returns 0 then)
+char* keyboard_wait_line_timeout(uint32_t timeout_ms) {
+    char *line = 0;
+    wait_event_timeout(&line_wait, (line = keyboard_get_line()) != 0, timeout_ms);
+    return line;
+}
+
 void keyboard_handler(void) {
     uint8_t scancode = inb(0x60);
     
@@ -78,6 +96,8 @@ void keyboard_handler(void) {
             input_buffer[buffer_pos] = '\0';
             input_ready = 1;
             buffer_pos = 0;
+            
+            wake_one(&line_wait);
         }
         // Display newline
         if (display_callback) {
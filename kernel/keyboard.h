@@ -6,4 +6,6 @@
 void keyboard_init(void);
 void keyboard_handler(void);
 char* keyboard_get_line(void);
+char* keyboard_wait_line(void);
+char* keyboard_wait_line_timeout(uint32_t timeout_ms);
 void keyboard_set_display_callback(void (*callback)(char));
\ No newline at end of file
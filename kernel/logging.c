@@ -1,4 +1,5 @@
 #include "logging.h"
+#include "clock.h"
 
 // Log buffer
 static log_entry_t log_buffer[MAX_LOG_ENTRIES];
@@ -31,7 +32,7 @@ void log_message(log_level_t level, const char *message) {
     
     // Get current entry
     log_entry_t *entry = &log_buffer[log_index];
-    entry->timestamp = 0;  // TODO: use actual tick count
+    entry->timestamp = clock_monotonic_ns();
     entry->level = level;
     
     // Copy message with bounds checking
@@ -76,8 +77,6 @@ void log_debug(const char *message) {
 
 // Print all log entries
 void logging_print_all(void) {
-    char buffer[64];
-    
     console_puts("\n=== System Log (dmesg) ===\n");
     
     if (log_count == 0) {
@@ -93,8 +92,7 @@ void logging_print_all(void) {
         log_entry_t *entry = &log_buffer[idx];
         
         console_puts("[");
-        itoa(entry->timestamp, buffer);
-        console_puts(buffer);
+        clock_print_timestamp(entry->timestamp);
         console_puts("] ");
         
         // Print log level
@@ -120,8 +118,6 @@ void logging_print_all(void) {
 
 // Print recent log entries
 void logging_print_recent(uint32_t count) {
-    char buffer[64];
-    
     console_puts("\n=== Recent Log Entries ===\n");
     
     if (log_count == 0) {
@@ -143,8 +139,7 @@ void logging_print_recent(uint32_t count) {
         log_entry_t *entry = &log_buffer[idx];
         
         console_puts("[");
-        itoa(entry->timestamp, buffer);
-        console_puts(buffer);
+        clock_print_timestamp(entry->timestamp);
         console_puts("] ");
         console_puts(entry->message);
         console_puts("\n");
@@ -18,7 +18,7 @@ typedef enum {
 
 // Log entry structure
 typedef struct {
-    uint32_t timestamp;         // Entry timestamp
+    uint64_t timestamp;         // Nanoseconds since boot (clock_monotonic_ns)
     log_level_t level;          // Log level
     char message[MAX_LOG_MESSAGE];  // Log message
 } log_entry_t;
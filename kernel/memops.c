@@ -0,0 +1,299 @@
+#include "memops.h"
+#include "memory.h"
+#include "cpu.h"
+
+// Bytes copied per interrupts-off SSE2 burst
+#define MEMOPS_SSE_CHUNK 4096
+
+// Set by memops_init() once SSE is enabled in CR0/CR4
+static int sse2_enabled = 0;
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+
+// Detect CPU features and enable SSE for the large-copy path
+void memops_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 1) {
+        return;  // No feature leaf
+    }
+    
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_SSE2)) {
+        return;
+    }
+    
+    // SSE instructions need CR0.EM clear and CR4.OSFXSR set
+    write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    sse2_enabled = 1;
+}
+
+// Returns 1 if the SSE2 non-temporal path is in use
+int memops_has_sse2(void) {
+    return sse2_enabled;
+}
+
+// Byte-at-a-time copy (benchmark baseline)
+static void copy_byte_loop(void *dest, const void *src, size_t size) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    for (size_t i = 0; i < size; i++) {
+        d[i] = s[i];
+        asm volatile("" : : : "memory");  // Keep the compiler from turning this into memcpy
+    }
+}
+
+// rep movsd for the bulk, rep movsb for the tail
+static void copy_rep(void *dest, const void *src, size_t size) {
+    size_t dwords = size >> 2;
+    size_t tail = size & 3;
+    asm volatile("rep movsl" : "+D"(dest), "+S"(src), "+c"(dwords) : : "memory");
+    asm volatile("rep movsb" : "+D"(dest), "+S"(src), "+c"(tail) : : "memory");
+}
+
+// SSE2 copy with non-temporal stores that bypass the cache
+static void copy_sse2_nt(void *dest, const void *src, size_t size) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    
+    // Align the destination for movntdq
+    size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head > size) {
+        head = size;
+    }
+    copy_rep(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+    
+    while (size >= 64) {
+        size_t chunk = (size < MEMOPS_SSE_CHUNK) ? (size & ~(size_t)63) : MEMOPS_SSE_CHUNK;
+        
+        // XMM registers are not part of any saved context, so keep
+        // interrupts off while they hold data
+        uint32_t flags = irq_save();
+        for (size_t i = 0; i < chunk; i += 64) {
+            asm volatile("movdqu (%0), %%xmm0\n\t"
+                         "movdqu 16(%0), %%xmm1\n\t"
+                         "movdqu 32(%0), %%xmm2\n\t"
+                         "movdqu 48(%0), %%xmm3\n\t"
+                         "movntdq %%xmm0, (%1)\n\t"
+                         "movntdq %%xmm1, 16(%1)\n\t"
+                         "movntdq %%xmm2, 32(%1)\n\t"
+                         "movntdq %%xmm3, 48(%1)"
+                         : : "r"(s + i), "r"(d + i) : "memory");
+        }
+        irq_restore(flags);
+        
+        d += chunk;
+        s += chunk;
+        size -= chunk;
+    }
+    
+    // Order the non-temporal stores before anything that follows
+    asm volatile("sfence" : : : "memory");
+    copy_rep(d, s, size);
+}
+
+// Byte-at-a-time fill (benchmark baseline)
+static void fill_byte_loop(void *ptr, int value, size_t size) {
+    uint8_t *p = (uint8_t *)ptr;
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (uint8_t)value;
+        asm volatile("" : : : "memory");  // Keep the compiler from turning this into memset
+    }
+}
+
+// rep stosd for the bulk, rep stosb for the tail
+static void fill_rep(void *ptr, int value, size_t size) {
+    uint32_t pattern = (uint8_t)value * 0x01010101u;
+    size_t dwords = size >> 2;
+    size_t tail = size & 3;
+    asm volatile("rep stosl" : "+D"(ptr), "+c"(dwords) : "a"(pattern) : "memory");
+    asm volatile("rep stosb" : "+D"(ptr), "+c"(tail) : "a"(pattern) : "memory");
+}
+
+// SSE2 fill with non-temporal stores
+static void fill_sse2_nt(void *ptr, int value, size_t size) {
+    uint8_t *p = (uint8_t *)ptr;
+    uint32_t pattern = (uint8_t)value * 0x01010101u;
+    
+    size_t head = (16 - ((uintptr_t)p & 15)) & 15;
+    if (head > size) {
+        head = size;
+    }
+    fill_rep(p, value, head);
+    p += head;
+    size -= head;
+    
+    while (size >= 64) {
+        size_t chunk = (size < MEMOPS_SSE_CHUNK) ? (size & ~(size_t)63) : MEMOPS_SSE_CHUNK;
+        
+        uint32_t flags = irq_save();
+        asm volatile("movd %0, %%xmm0\n\t"
+                     "pshufd $0, %%xmm0, %%xmm0"
+                     : : "r"(pattern));
+        for (size_t i = 0; i < chunk; i += 64) {
+            asm volatile("movntdq %%xmm0, (%0)\n\t"
+                         "movntdq %%xmm0, 16(%0)\n\t"
+                         "movntdq %%xmm0, 32(%0)\n\t"
+                         "movntdq %%xmm0, 48(%0)"
+                         : : "r"(p + i) : "memory");
+        }
+        irq_restore(flags);
+        
+        p += chunk;
+        size -= chunk;
+    }
+    
+    asm volatile("sfence" : : : "memory");
+    fill_rep(p, value, size);
+}
+
+// Initialize a memory region with a value
+void *memset(void *ptr, int value, size_t size) {
+    if (size < MEMOPS_REP_THRESHOLD) {
+        void *p = ptr;
+        asm volatile("rep stosb" : "+D"(p), "+c"(size) : "a"(value) : "memory");
+    } else if (size >= MEMOPS_NT_THRESHOLD && sse2_enabled) {
+        fill_sse2_nt(ptr, value, size);
+    } else {
+        fill_rep(ptr, value, size);
+    }
+    return ptr;
+}
+
+// Copy memory from source to destination
+void *memcpy(void *dest, const void *src, size_t size) {
+    if (size < MEMOPS_REP_THRESHOLD) {
+        void *d = dest;
+        asm volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(size) : : "memory");
+    } else if (size >= MEMOPS_NT_THRESHOLD && sse2_enabled) {
+        copy_sse2_nt(dest, src, size);
+    } else {
+        copy_rep(dest, src, size);
+    }
+    return dest;
+}
+
+// Copy memory between possibly overlapping regions
+void *memmove(void *dest, const void *src, size_t size) {
+    uint8_t *d = (uint8_t *)dest;
+    const uint8_t *s = (const uint8_t *)src;
+    
+    // Forward copy is safe unless dest starts inside src
+    if (d <= s || d >= s + size) {
+        return memcpy(dest, src, size);
+    }
+    
+    // Copy backwards: the trailing bytes first, then whole dwords
+    uint8_t *d_end = d + size - 1;
+    const uint8_t *s_end = s + size - 1;
+    size_t tail = size & 3;
+    size_t dwords = size >> 2;
+    asm volatile("std\n\t"
+                 "rep movsb\n\t"
+                 "sub $3, %%edi\n\t"
+                 "sub $3, %%esi\n\t"
+                 "mov %3, %%ecx\n\t"
+                 "rep movsl\n\t"
+                 "cld"
+                 : "+D"(d_end), "+S"(s_end), "+c"(tail)
+                 : "r"(dwords)
+                 : "memory", "cc");
+    return dest;
+}
+
+// Print bytes-per-cycle as a fixed-point number with two decimals
+static void print_rate(uint32_t bytes, uint32_t cycles) {
+    char buffer[16];
+    
+    if (cycles == 0) {
+        cycles = 1;
+    }
+    uint32_t rate = (bytes * 100) / cycles;
+    
+    itoa(rate / 100, buffer);
+    console_puts(buffer);
+    console_puts(".");
+    if (rate % 100 < 10) {
+        console_puts("0");
+    }
+    itoa(rate % 100, buffer);
+    console_puts(buffer);
+}
+
+// Run the copy/fill microbenchmark and print bytes per cycle
+void memops_benchmark(void) {
+    static const uint32_t sizes[] = { 256, 4096, 65536, 1048576 };
+    const uint32_t total_bytes = 1048576;  // Bytes moved per measurement
+    char buffer[16];
+    
+    uint8_t *src = (uint8_t *)malloc(total_bytes);
+    uint8_t *dst = (uint8_t *)malloc(total_bytes);
+    if (!src || !dst) {
+        free(src);
+        free(dst);
+        console_puts("Error: Not enough memory for benchmark buffers\n");
+        return;
+    }
+    fill_rep(src, 0x5A, total_bytes);
+    fill_rep(dst, 0, total_bytes);
+    
+    void (*copies[3])(void *, const void *, size_t) = { copy_byte_loop, copy_rep, copy_sse2_nt };
+    void (*fills[3])(void *, int, size_t) = { fill_byte_loop, fill_rep, fill_sse2_nt };
+    uint32_t variants = sse2_enabled ? 3 : 2;
+    
+    console_puts("\n=== Memory Ops Benchmark (bytes/cycle) ===\n");
+    console_puts("Variants: byte | rep movsd/stosd");
+    console_puts(sse2_enabled ? " | sse2 non-temporal\n" : " (no SSE2)\n");
+    
+    for (uint32_t op = 0; op < 2; op++) {
+        for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            uint32_t size = sizes[i];
+            uint32_t iterations = total_bytes / size;
+            
+            console_puts(op == 0 ? "memcpy " : "memset ");
+            if (size >= 1024) {
+                itoa(size / 1024, buffer);
+                console_puts(buffer);
+                console_puts("KB");
+            } else {
+                itoa(size, buffer);
+                console_puts(buffer);
+                console_puts("B");
+            }
+            console_puts(":");
+            
+            for (uint32_t v = 0; v < variants; v++) {
+                // One warm-up pass, then the timed run
+                if (op == 0) {
+                    copies[v](dst, src, size);
+                } else {
+                    fills[v](dst, 0xA5, size);
+                }
+                
+                uint64_t start = rdtsc();
+                for (uint32_t n = 0; n < iterations; n++) {
+                    if (op == 0) {
+                        copies[v](dst, src, size);
+                    } else {
+                        fills[v](dst, 0xA5, size);
+                    }
+                }
+                uint32_t cycles = (uint32_t)(rdtsc() - start);
+                
+                console_puts(v == 0 ? " " : " | ");
+                print_rate(iterations * size, cycles);
+            }
+            console_puts("\n");
+        }
+    }
+    
+    free(src);
+    free(dst);
+}
@@ -0,0 +1,30 @@
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Size thresholds for the copy/fill strategies
+#define MEMOPS_REP_THRESHOLD 16        // Below this, plain rep movsb/stosb
+#define MEMOPS_NT_THRESHOLD 65536      // From this size, SSE2 non-temporal stores
+
+// Detect CPU features and enable SSE for the large-copy path (on each
+// CPU as it comes up)
+void memops_init(void);
+
+// Returns 1 if the SSE2 non-temporal path is in use
+int memops_has_sse2(void);
+
+// Initialize a memory region with a value
+void *memset(void *ptr, int value, size_t size);
+
+// Copy memory from source to destination (regions must not overlap)
+void *memcpy(void *dest, const void *src, size_t size);
+
+// Copy memory between possibly overlapping regions
+void *memmove(void *dest, const void *src, size_t size);
+
+// Run the copy/fill microbenchmark and print bytes per cycle
+void memops_benchmark(void);
+
+#endif // MEMOPS_H
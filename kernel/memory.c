@@ -1,4 +1,12 @@
 #include "memory.h"
+#include "page.h"
+#include "scheduler.h"
+#include "cpu.h"
+#include "spinlock.h"
+
+// Serializes every heap operation across CPUs (taken by the public
+// wrappers only; the do_* helpers assume it is held)
+static spinlock_t heap_lock = SPINLOCK_INIT;
 
 // Memory pool
 static uint8_t memory_pool[MEMORY_SIZE] __attribute__((section(".bss")));
@@ -9,11 +17,190 @@ static memory_block_t *memory_head = NULL;
 // Memory statistics
 static memory_stats_t mem_stats = {0};
 
+// Segregated free lists, one per size class
+static memory_block_t *free_lists[MEMORY_CLASS_COUNT];
+
+// Bit N set when free_lists[N] is non-empty
+static uint32_t free_class_bitmap = 0;
+
+// Relocatable allocations, indexed by handle - 1
+static memory_handle_t handle_table[MEMORY_HANDLE_MAX];
+
+// Set when a free or unlock may have given the compactor work
+static int compact_pending = 0;
+
+// Pre-zeroed blocks per pool size and pre-zeroed page frames, both
+// refilled by memory_zero_refill() from the idle loop
+static void *zero_blocks[MEMORY_ZERO_CLASSES][MEMORY_ZERO_BLOCKS];
+static uint32_t zero_block_count[MEMORY_ZERO_CLASSES];
+static void *zero_pages[MEMORY_ZERO_PAGES];
+static uint32_t zero_page_count = 0;
+
 // External function from kernel.c for console output
 void console_puts(const char *s);
 void console_putchar(char c);
 
 void itoa(int num, char *str);
+void itoa_hex(uint32_t num, char *str);
+
+#ifdef MEMORY_TRACE
+// Live allocations by trace slot, and a stack of unused slots
+static memory_trace_t trace_table[MEMORY_TRACE_ENTRIES];
+static uint16_t trace_free_slots[MEMORY_TRACE_ENTRIES];
+static uint32_t trace_free_top = 0;
+static uint32_t trace_dropped = 0;
+
+// Reset the trace table
+static void trace_init(void) {
+    for (uint32_t i = 0; i < MEMORY_TRACE_ENTRIES; i++) {
+        trace_table[i].block = NULL;
+        trace_free_slots[i] = MEMORY_TRACE_ENTRIES - 1 - i;
+    }
+    trace_free_top = MEMORY_TRACE_ENTRIES;
+    trace_dropped = 0;
+}
+
+// Record the caller of a successful allocation; a block resized in place
+// keeps its slot
+static void trace_alloc(void *ptr, size_t size, void *caller) {
+    if (!ptr) {
+        return;
+    }
+    
+    memory_block_t *block = (memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t));
+    uint32_t slot = block->trace_slot;
+    
+    if (slot >= MEMORY_TRACE_ENTRIES || trace_table[slot].block != block) {
+        if (trace_free_top == 0) {
+            block->trace_slot = MEMORY_TRACE_NONE;
+            trace_dropped++;  // Table full
+            return;
+        }
+        slot = trace_free_slots[--trace_free_top];
+        block->trace_slot = slot;
+    }
+    
+    trace_table[slot].block = block;
+    trace_table[slot].caller = caller;
+    trace_table[slot].size = size;
+    trace_table[slot].tick = scheduler_get_ticks();
+}
+
+// Drop a block's trace entry
+static void trace_free(memory_block_t *block) {
+    uint32_t slot = block->trace_slot;
+    
+    if (slot < MEMORY_TRACE_ENTRIES && trace_table[slot].block == block) {
+        trace_table[slot].block = NULL;
+        trace_free_slots[trace_free_top++] = slot;
+    }
+    block->trace_slot = MEMORY_TRACE_NONE;
+}
+
+// Follow a block the compactor is about to move
+static void trace_move(memory_block_t *from, memory_block_t *to) {
+    uint32_t slot = from->trace_slot;
+    
+    if (slot < MEMORY_TRACE_ENTRIES && trace_table[slot].block == from) {
+        trace_table[slot].block = to;
+    }
+}
+
+#define TRACE_ALLOC(ptr, size) trace_alloc((ptr), (size), __builtin_return_address(0))
+#define TRACE_FREE(block) trace_free(block)
+#define TRACE_MOVE(from, to) trace_move((from), (to))
+#else
+#define TRACE_ALLOC(ptr, size) ((void)0)
+#define TRACE_FREE(block) ((void)0)
+#define TRACE_MOVE(from, to) ((void)0)
+#endif
+
+// Free-list links: in the header in debug builds, in the otherwise unused
+// payload of the free block in release builds
+static inline memory_free_links_t *block_links(memory_block_t *block) {
+#ifdef MEMORY_RELEASE
+    return (memory_free_links_t *)((uint8_t *)block + sizeof(memory_block_t));
+#else
+    return &block->links;
+#endif
+}
+
+// Boundary tag at the end of a block
+static inline memory_footer_t *block_footer(memory_block_t *block) {
+    return (memory_footer_t *)((uint8_t *)block + sizeof(memory_block_t) + block->size);
+}
+
+// Rewrite a block's footer after its size changed
+static inline void block_set_footer(memory_block_t *block) {
+    block_footer(block)->header = block;
+}
+
+// Physically following block, or NULL at the end of the pool
+static inline memory_block_t *block_next(memory_block_t *block) {
+    uint8_t *next = (uint8_t *)block_footer(block) + sizeof(memory_footer_t);
+    if (next >= memory_pool + MEMORY_SIZE) {
+        return NULL;
+    }
+    return (memory_block_t *)next;
+}
+
+// Physically preceding block, found through its footer
+static inline memory_block_t *block_prev(memory_block_t *block) {
+    if ((uint8_t *)block == memory_pool) {
+        return NULL;
+    }
+    memory_footer_t *footer = (memory_footer_t *)((uint8_t *)block - sizeof(memory_footer_t));
+    return footer->header;
+}
+
+// Size class holding blocks of this size (floor(log2(size)) - MIN_SHIFT)
+static inline uint32_t size_to_class(uint32_t size) {
+    uint32_t log2 = 31 - __builtin_clz(size);
+    if (log2 < MEMORY_CLASS_MIN_SHIFT) {
+        return 0;
+    }
+    if (log2 - MEMORY_CLASS_MIN_SHIFT >= MEMORY_CLASS_COUNT) {
+        return MEMORY_CLASS_COUNT - 1;
+    }
+    return log2 - MEMORY_CLASS_MIN_SHIFT;
+}
+
+// Push a free block onto the head of its size-class list
+static void freelist_insert(memory_block_t *block) {
+    uint32_t cls = size_to_class(block->size);
+    
+    block_links(block)->prev = NULL;
+    block_links(block)->next = free_lists[cls];
+    if (free_lists[cls]) {
+        block_links(free_lists[cls])->prev = block;
+    }
+    free_lists[cls] = block;
+    
+    free_class_bitmap |= (1u << cls);
+    mem_stats.class_free_blocks[cls]++;
+}
+
+// Unlink a free block from its size-class list
+static void freelist_remove(memory_block_t *block) {
+    uint32_t cls = size_to_class(block->size);
+    
+    memory_free_links_t *links = block_links(block);
+    if (links->prev) {
+        block_links(links->prev)->next = links->next;
+    } else {
+        free_lists[cls] = links->next;
+    }
+    if (links->next) {
+        block_links(links->next)->prev = links->prev;
+    }
+    links->next = NULL;
+    links->prev = NULL;
+    
+    if (!free_lists[cls]) {
+        free_class_bitmap &= ~(1u << cls);
+    }
+    mem_stats.class_free_blocks[cls]--;
+}
 
 // Initialize memory management system
 void memory_init(void) {
@@ -24,78 +211,143 @@ void memory_init(void) {
     mem_stats.block_count = 0;
     mem_stats.allocation_count = 0;
     mem_stats.free_count = 0;
+    mem_stats.large_count = 0;
+    mem_stats.large_memory = 0;
+    mem_stats.peak_used_memory = 0;
+    mem_stats.failed_allocations = 0;
+    mem_stats.handle_count = 0;
+    mem_stats.compact_moves = 0;
+    mem_stats.compact_bytes = 0;
+    mem_stats.zero_pool_pages = 0;
+    mem_stats.zero_pool_bytes = 0;
+    mem_stats.zero_hits = 0;
+    mem_stats.zero_misses = 0;
+    mem_stats.largest_free_block = 0;
+    mem_stats.fragmentation = 0;
+    for (uint32_t i = 0; i < MEMORY_HISTOGRAM_BUCKETS; i++) {
+        mem_stats.size_histogram[i] = 0;
+    }
+    for (uint32_t i = 0; i < MEMORY_CLASS_COUNT; i++) {
+        mem_stats.class_allocs[i] = 0;
+        mem_stats.class_free_blocks[i] = 0;
+        free_lists[i] = NULL;
+    }
+    free_class_bitmap = 0;
     
-    // Clear the memory pool
-    memset(memory_pool, 0, MEMORY_SIZE);
+    for (uint32_t i = 0; i < MEMORY_HANDLE_MAX; i++) {
+        handle_table[i].ptr = NULL;
+        handle_table[i].lock_count = 0;
+    }
+    compact_pending = 0;
     
+    for (uint32_t i = 0; i < MEMORY_ZERO_CLASSES; i++) {
+        zero_block_count[i] = 0;
+    }
+    zero_page_count = 0;
+
+#ifdef MEMORY_TRACE
+    trace_init();
+#endif
+    
+    // The pool is not cleared: callers that need zeroed memory get it
+    // from kzalloc(), which zeroes on demand or takes pre-zeroed blocks
     // Create initial free block
     memory_head = (memory_block_t *)memory_pool;
-    memory_head->size = MEMORY_SIZE - sizeof(memory_block_t);
-    memory_head->capacity = memory_head->size - MEMORY_GUARD_SIZE;
-    memory_head->used = 0;
+    memory_head->size = MEMORY_SIZE - MEMORY_BLOCK_OVERHEAD;
     memory_head->is_free = 1;
-    memory_head->guard_start = 0;
-    memory_head->next = NULL;
+    memory_head->is_large = 0;
+    block_set_footer(memory_head);
+    freelist_insert(memory_head);
     
     mem_stats.block_count = 1;
     mem_stats.free_memory = memory_head->size;
 }
 
-// Find a suitable memory block for allocation
-static memory_block_t *find_free_block(size_t size) {
-    memory_block_t *current = memory_head;
+// Find a suitable memory block for allocation in O(1)
+static memory_block_t *find_free_block(uint32_t size) {
+    uint32_t cls = size_to_class(size);
     
-    while (current) {
-        if (current->is_free && current->size >= size) {
-            return current;
-        }
-        current = current->next;
+    // The head of the request's own class may already be large enough
+    if (free_lists[cls] && free_lists[cls]->size >= size) {
+        return free_lists[cls];
     }
     
-    return NULL;
+    // Otherwise any block from a strictly larger class fits
+    if (cls + 1 >= MEMORY_CLASS_COUNT) {
+        return NULL;
+    }
+    uint32_t mask = free_class_bitmap & (~0u << (cls + 1));
+    if (!mask) {
+        return NULL;
+    }
+    
+    return free_lists[__builtin_ctz(mask)];
 }
 
-// Allocate memory
-void *malloc(size_t size) {
-    if (size == 0 || size > 65536) {  // MAX_FILE_SIZE = 65536
-        return NULL;  // Invalid size or too large
+// Count a request in the log2 size histogram
+static inline void record_request(size_t size) {
+    uint32_t bucket = 31 - __builtin_clz((uint32_t)size);
+    if (bucket >= MEMORY_HISTOGRAM_BUCKETS) {
+        bucket = MEMORY_HISTOGRAM_BUCKETS - 1;
     }
-    
-    // Round up to minimum block size
+    mem_stats.size_histogram[bucket]++;
+}
+
+// Track the high-water mark of memory in use
+static inline void update_peak(void) {
+    uint32_t in_use = mem_stats.used_memory + mem_stats.large_memory;
+    if (in_use > mem_stats.peak_used_memory) {
+        mem_stats.peak_used_memory = in_use;
+    }
+}
+
+// Round a request up to the allocator's minimum size and alignment
+static inline uint32_t normalize_size(size_t size) {
     if (size < MEMORY_BLOCK_SIZE) {
         size = MEMORY_BLOCK_SIZE;
     }
+    return (size + MEMORY_ALIGN - 1) & ~(MEMORY_ALIGN - 1);
+}
+
+// Split the unused end of an allocated block off as a free block
+static void split_block_tail(memory_block_t *block, uint32_t total_size) {
+    if (block->size < total_size + MEMORY_BLOCK_OVERHEAD + MEMORY_BLOCK_SIZE) {
+        return;  // Remainder too small to be a block of its own
+    }
     
-    // Add space for guard bytes
-    uint32_t total_size = size + MEMORY_GUARD_SIZE;
+    memory_block_t *tail = (memory_block_t *)((uint8_t *)block + sizeof(memory_block_t) +
+                                              total_size + sizeof(memory_footer_t));
+    tail->size = block->size - total_size - MEMORY_BLOCK_OVERHEAD;
+    tail->is_free = 1;
+    tail->is_large = 0;
+    block_set_footer(tail);
     
-    // Find a free block
-    memory_block_t *block = find_free_block(total_size);
+    mem_stats.used_memory -= block->size - total_size;
+    mem_stats.free_memory += tail->size;
+    mem_stats.block_count++;
     
-    if (!block) {
-        return NULL;  // Out of memory
-    }
+    block->size = total_size;
+    block_set_footer(block);
     
-    // If block is larger than needed, split it
-    if (block->size > total_size + sizeof(memory_block_t)) {
-        memory_block_t *new_block = (memory_block_t *)((uint8_t *)block + sizeof(memory_block_t) + total_size);
-        new_block->size = block->size - total_size - sizeof(memory_block_t);
-        new_block->capacity = new_block->size - MEMORY_GUARD_SIZE;
-        new_block->used = 0;
-        new_block->is_free = 1;
-        new_block->guard_start = 0;
-        new_block->next = block->next;
-        
-        block->next = new_block;
-        block->size = total_size;
-        mem_stats.block_count++;
-        mem_stats.free_memory -= (total_size + sizeof(memory_block_t));
-    } else {
-        mem_stats.free_memory -= block->size;
+    // A shrinking block may have a free successor to merge with
+    memory_block_t *next = block_next(tail);
+    if (next && next->is_free) {
+        freelist_remove(next);
+        tail->size += MEMORY_BLOCK_OVERHEAD + next->size;
+        block_set_footer(tail);
+        mem_stats.block_count--;
+        mem_stats.free_memory += MEMORY_BLOCK_OVERHEAD;
     }
     
-    // Mark block as allocated and set capacity/used
-    block->is_free = 0;
+    freelist_insert(tail);
+}
+
+// Set an allocated block's capacity and rewrite its guards (debug builds only)
+static inline void block_set_capacity(memory_block_t *block, uint32_t size) {
+#ifdef MEMORY_RELEASE
+    (void)block;
+    (void)size;
+#else
     block->capacity = size;
     block->used = 0;
     block->guard_start = MEMORY_GUARD_BYTE;
@@ -104,16 +356,398 @@ void *malloc(size_t size) {
     uint8_t *guard_ptr = (uint8_t *)block + sizeof(memory_block_t) + size;
     uint32_t *guard = (uint32_t *)guard_ptr;
     *guard = MEMORY_GUARD_BYTE;
+#endif
+}
+
+// Bytes of an allocated block's payload that hold caller data
+static inline uint32_t block_capacity(memory_block_t *block) {
+#ifdef MEMORY_RELEASE
+    return block->size;
+#else
+    return block->capacity;
+#endif
+}
+
+// Carve an allocation of `size` payload bytes out of a block already
+// removed from the free lists, returning any tail to the free lists
+static void *allocate_block(memory_block_t *block, uint32_t size) {
+    // Add space for guard bytes
+    uint32_t total_size = size + MEMORY_GUARD_SIZE;
     
+    // Mark block as allocated
+    block->is_free = 0;
+    block->handle = 0;
+    mem_stats.free_memory -= block->size;
     mem_stats.used_memory += block->size;
+    
+    // If block is larger than needed, split it
+    split_block_tail(block, total_size);
+    block_set_capacity(block, size);
+    
     mem_stats.allocation_count++;
+    mem_stats.class_allocs[size_to_class(total_size)]++;
+    update_peak();
     
     // Return pointer to memory after metadata
     return (void *)((uint8_t *)block + sizeof(memory_block_t));
 }
 
-// Free memory
-void free(void *ptr) {
+// Allocate a large block directly from the page allocator
+static void *allocate_large(uint32_t size) {
+    uint32_t order = page_order_for_size(sizeof(memory_block_t) + size + MEMORY_GUARD_SIZE);
+    memory_block_t *block = (memory_block_t *)alloc_pages(order);
+    if (!block) {
+        return NULL;  // Out of memory
+    }
+    
+    block->size = (PAGE_SIZE << order) - sizeof(memory_block_t);
+    block->is_free = 0;
+    block->is_large = 1;
+    block->handle = 0;
+    block_set_capacity(block, size);
+    
+    mem_stats.large_count++;
+    mem_stats.large_memory += PAGE_SIZE << order;
+    mem_stats.allocation_count++;
+    update_peak();
+    
+    return (void *)((uint8_t *)block + sizeof(memory_block_t));
+}
+
+// Release a page-backed block
+static void free_large(memory_block_t *block) {
+    uint32_t bytes = block->size + sizeof(memory_block_t);
+    
+    block->is_free = 1;
+    mem_stats.large_count--;
+    mem_stats.large_memory -= bytes;
+    mem_stats.free_count++;
+    
+    free_pages(block, page_order_for_size(bytes));
+}
+
+// Allocate a normalized size from the pool or, for large requests, pages
+static void *heap_alloc(uint32_t size) {
+    // Large requests skip the pool entirely
+    if (size > MEMORY_LARGE_THRESHOLD) {
+        return allocate_large(size);
+    }
+    
+    // Find a free block
+    memory_block_t *block = find_free_block(size + MEMORY_GUARD_SIZE);
+    
+    if (!block) {
+        // Pool exhausted or fragmented: fall back to whole pages. Compacting
+        // is left to the idle loop, never done here with interrupts off.
+        return allocate_large(size);
+    }
+    
+    freelist_remove(block);
+    return allocate_block(block, size);
+}
+
+// Validate, count and serve a malloc() request
+static void *do_malloc(size_t size) {
+    if (size == 0 || size > (PAGE_SIZE << PAGE_MAX_ORDER) - MEMORY_BLOCK_OVERHEAD) {
+        return NULL;  // Invalid size or too large
+    }
+    
+    record_request(size);
+    
+    void *ptr = heap_alloc(normalize_size(size));
+    if (!ptr) {
+        mem_stats.failed_allocations++;
+    }
+    return ptr;
+}
+
+// Allocate memory
+void *malloc(size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = do_malloc(size);
+    TRACE_ALLOC(ptr, size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// Carve an aligned allocation out of the pool
+static void *do_memalign(size_t alignment, size_t size) {
+    if (size == 0 || size > 65536) {
+        return NULL;  // Invalid size or too large
+    }
+    
+    if (alignment <= MEMORY_ALIGN) {
+        return do_malloc(size);
+    }
+    
+    if (alignment & (alignment - 1)) {
+        return NULL;  // Alignment must be a power of two
+    }
+    
+    record_request(size);
+    size = normalize_size(size);
+    
+    // Worst case the payload moves forward by a whole free block plus alignment
+    uint32_t min_gap = MEMORY_BLOCK_OVERHEAD + MEMORY_BLOCK_SIZE;
+    memory_block_t *block = find_free_block(size + MEMORY_GUARD_SIZE + alignment + min_gap);
+    
+    if (!block) {
+        mem_stats.failed_allocations++;
+        return NULL;  // Out of memory
+    }
+    
+    freelist_remove(block);
+    
+    // Find the first aligned payload that leaves room for a free block in front
+    uintptr_t payload = (uintptr_t)block + sizeof(memory_block_t);
+    uintptr_t aligned = (payload + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    while (aligned != payload && aligned - payload < min_gap) {
+        aligned += alignment;
+    }
+    
+    // Split the leading gap off as its own free block
+    if (aligned != payload) {
+        uint32_t gap = aligned - payload;
+        memory_block_t *aligned_block = (memory_block_t *)(aligned - sizeof(memory_block_t));
+        
+        // The header lands on old payload bytes: set every flag
+        aligned_block->size = block->size - gap;
+        aligned_block->is_free = 1;
+        aligned_block->is_large = 0;
+        block_set_footer(aligned_block);
+        
+        block->size = gap - MEMORY_BLOCK_OVERHEAD;
+        block_set_footer(block);
+        freelist_insert(block);
+        
+        mem_stats.block_count++;
+        mem_stats.free_memory -= MEMORY_BLOCK_OVERHEAD;
+        block = aligned_block;
+    }
+    
+    return allocate_block(block, size);
+}
+
+// Allocate memory with an aligned payload
+void *memalign(size_t alignment, size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = do_memalign(alignment, size);
+    TRACE_ALLOC(ptr, size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// Pre-zeroed pool size index for a normalized size
+static inline uint32_t zero_class(uint32_t size) {
+    uint32_t cls = 0;
+    while ((1u << (cls + MEMORY_ZERO_MIN_SHIFT)) < size) {
+        cls++;
+    }
+    return cls;
+}
+
+// Serve a zeroed allocation, from the pre-zeroed pool when possible
+static void *do_kzalloc(size_t size) {
+    if (size > 0 && size <= (1u << (MEMORY_ZERO_MIN_SHIFT + MEMORY_ZERO_CLASSES - 1))) {
+        uint32_t normalized = normalize_size(size);
+        uint32_t cls = zero_class(normalized);
+        
+        if (zero_block_count[cls] > 0) {
+            void *ptr = zero_blocks[cls][--zero_block_count[cls]];
+            memory_block_t *block = (memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t));
+            
+            // Shrink the recorded capacity to what was asked for
+            block_set_capacity(block, normalized);
+            mem_stats.zero_pool_bytes -= block->size;
+            mem_stats.zero_hits++;
+            record_request(size);
+            return ptr;
+        }
+    }
+    
+    void *ptr = do_malloc(size);
+    if (ptr) {
+        memset(ptr, 0, size);
+        mem_stats.zero_misses++;
+    }
+    return ptr;
+}
+
+// Allocate zeroed memory
+void *kzalloc(size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = do_kzalloc(size);
+    TRACE_ALLOC(ptr, size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// Allocate zero-initialized memory for an array
+void *calloc(size_t count, size_t size) {
+    if (size != 0 && count > 0xFFFFFFFFu / size) {
+        return NULL;  // Size overflows
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = do_kzalloc(count * size);
+    TRACE_ALLOC(ptr, count * size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// Pop a pre-zeroed frame or zero a fresh one
+static void *do_kzalloc_page(void) {
+    if (zero_page_count > 0) {
+        mem_stats.zero_pool_pages--;
+        mem_stats.zero_hits++;
+        return zero_pages[--zero_page_count];
+    }
+    
+    void *page = alloc_pages(0);
+    if (page) {
+        memset(page, 0, PAGE_SIZE);
+        mem_stats.zero_misses++;
+    }
+    return page;
+}
+
+// Allocate one zeroed page frame
+void *kzalloc_page(void) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *page = do_kzalloc_page();
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return page;
+}
+
+// Refill the pre-zeroed pools within a byte budget
+static uint32_t do_zero_refill(uint32_t max_bytes) {
+    uint32_t zeroed = 0;
+    
+    // Small blocks first; leave the pool alone when it is running low
+    for (uint32_t cls = 0; cls < MEMORY_ZERO_CLASSES; cls++) {
+        uint32_t size = 1u << (cls + MEMORY_ZERO_MIN_SHIFT);
+        
+        while (zero_block_count[cls] < MEMORY_ZERO_BLOCKS && zeroed < max_bytes) {
+            if (mem_stats.free_memory < MEMORY_SIZE / 8) {
+                break;
+            }
+            
+            memory_block_t *block = find_free_block(size + MEMORY_GUARD_SIZE);
+            if (!block) {
+                break;
+            }
+            freelist_remove(block);
+            
+            void *ptr = allocate_block(block, size);
+            memset(ptr, 0, size);
+            zero_blocks[cls][zero_block_count[cls]++] = ptr;
+            mem_stats.zero_pool_bytes += block->size;
+            zeroed += size;
+        }
+    }
+    
+    while (zero_page_count < MEMORY_ZERO_PAGES && zeroed < max_bytes) {
+        void *page = alloc_pages(0);
+        if (!page) {
+            break;
+        }
+        memset(page, 0, PAGE_SIZE);
+        zero_pages[zero_page_count++] = page;
+        mem_stats.zero_pool_pages++;
+        zeroed += PAGE_SIZE;
+    }
+    
+    return zeroed;
+}
+
+// Zero blocks and page frames ahead of demand until the pools are full
+// or max_bytes have been zeroed; returns bytes zeroed
+uint32_t memory_zero_refill(uint32_t max_bytes) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    uint32_t zeroed = do_zero_refill(max_bytes);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return zeroed;
+}
+
+static void do_free(void *ptr);
+
+// Resize an allocation, growing in place when the next block is free
+static void *do_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return do_malloc(size);
+    }
+    
+    if (size == 0) {
+        do_free(ptr);
+        return NULL;
+    }
+    
+    if (!memory_is_valid_ptr(ptr) || size > (PAGE_SIZE << PAGE_MAX_ORDER) - MEMORY_BLOCK_OVERHEAD) {
+        return NULL;  // Not a heap pointer or too large
+    }
+    
+    record_request(size);
+    
+    memory_block_t *block = (memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t));
+    uint32_t new_size = normalize_size(size);
+    uint32_t total_size = new_size + MEMORY_GUARD_SIZE;
+    uint32_t old_capacity = block_capacity(block);
+    
+    if (block->is_large) {
+        // Page-backed blocks can use whatever is left in their pages
+        if (total_size <= block->size) {
+            block_set_capacity(block, new_size);
+            return ptr;
+        }
+    } else {
+        // Shrink, or grow into the slack already in this block
+        if (total_size <= block->size) {
+            split_block_tail(block, total_size);
+            block_set_capacity(block, new_size);
+            return ptr;
+        }
+        
+        // Grow into a free successor without moving the data
+        memory_block_t *next = block_next(block);
+        if (next && next->is_free && block->size + MEMORY_BLOCK_OVERHEAD + next->size >= total_size) {
+            freelist_remove(next);
+            mem_stats.free_memory -= next->size;
+            mem_stats.used_memory += MEMORY_BLOCK_OVERHEAD + next->size;
+            mem_stats.block_count--;
+            
+            block->size += MEMORY_BLOCK_OVERHEAD + next->size;
+            block_set_footer(block);
+            
+            split_block_tail(block, total_size);
+            block_set_capacity(block, new_size);
+            update_peak();
+            return ptr;
+        }
+    }
+    
+    // Fall back to allocate, copy and free
+    void *new_ptr = heap_alloc(new_size);
+    if (!new_ptr) {
+        mem_stats.failed_allocations++;
+        return NULL;  // Out of memory, original block untouched
+    }
+    
+    memcpy(new_ptr, ptr, old_capacity < new_size ? old_capacity : new_size);
+    do_free(ptr);
+    return new_ptr;
+}
+
+// Resize an allocation
+void *realloc(void *ptr, size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *new_ptr = do_realloc(ptr, size);
+    TRACE_ALLOC(new_ptr, size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return new_ptr;
+}
+
+// Return a block to the pool or the page allocator
+static void do_free(void *ptr) {
     if (ptr == NULL) {
         return;
     }
@@ -121,42 +755,321 @@ void free(void *ptr) {
     // Find the block metadata (it's right before the pointer)
     memory_block_t *block = (memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t));
     
+    // Page-backed blocks go straight back to the page allocator
+    if (page_is_allocated(block)) {
+        if (block->is_large && !block->is_free) {
+            TRACE_FREE(block);
+            free_large(block);
+        }
+        return;
+    }
+    
+    if (!memory_is_valid_ptr(ptr)) {
+        return;  // Not a heap pointer
+    }
+    
     if (block->is_free) {
         return;  // Already free
     }
     
+    TRACE_FREE(block);
+    
     // Mark as free
     block->is_free = 1;
+    compact_pending = 1;
     mem_stats.used_memory -= block->size;
     mem_stats.free_memory += block->size;
     mem_stats.free_count++;
     
     // Coalesce with next block if it's free
-    if (block->next && block->next->is_free) {
-        block->size += sizeof(memory_block_t) + block->next->size;
-        block->next = block->next->next;
+    memory_block_t *next = block_next(block);
+    if (next && next->is_free) {
+        freelist_remove(next);
+        block->size += MEMORY_BLOCK_OVERHEAD + next->size;
+        block_set_footer(block);
         mem_stats.block_count--;
+        mem_stats.free_memory += MEMORY_BLOCK_OVERHEAD;
+    }
+    
+    // Coalesce with previous block if it's free (found via its boundary tag)
+    memory_block_t *prev = block_prev(block);
+    if (prev && prev->is_free) {
+        freelist_remove(prev);
+        prev->size += MEMORY_BLOCK_OVERHEAD + block->size;
+        block_set_footer(prev);
+        mem_stats.block_count--;
+        mem_stats.free_memory += MEMORY_BLOCK_OVERHEAD;
+        block = prev;
+    }
+    
+    freelist_insert(block);
+}
+
+// Free memory
+void free(void *ptr) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    do_free(ptr);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+// Table entry of a live handle, or NULL
+static memory_handle_t *handle_entry(mem_handle_t handle) {
+    if (handle == 0 || handle > MEMORY_HANDLE_MAX || !handle_table[handle - 1].ptr) {
+        return NULL;
+    }
+    return &handle_table[handle - 1];
+}
+
+// Allocate a block and bind it to a free handle slot
+static mem_handle_t do_halloc(size_t size) {
+    uint32_t index = 0;
+    while (index < MEMORY_HANDLE_MAX && handle_table[index].ptr) {
+        index++;
+    }
+    if (index == MEMORY_HANDLE_MAX) {
+        return 0;  // No free handles
+    }
+    
+    void *ptr = do_malloc(size);
+    if (!ptr) {
+        return 0;  // Out of memory
+    }
+    
+    ((memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t)))->handle = index + 1;
+    handle_table[index].ptr = ptr;
+    handle_table[index].lock_count = 0;
+    mem_stats.handle_count++;
+    
+    return index + 1;
+}
+
+// Allocate a relocatable block
+mem_handle_t halloc(size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    mem_handle_t handle = do_halloc(size);
+    if (handle) {
+        TRACE_ALLOC(handle_table[handle - 1].ptr, size);
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return handle;
+}
+
+// Resize a handle's block and rebind the handle to it
+static int do_hrealloc(mem_handle_t handle, size_t size) {
+    memory_handle_t *entry = handle_entry(handle);
+    if (!entry || size == 0) {
+        return 0;
+    }
+    
+    // Pin the block: realloc may compact the pool while it still needs it
+    entry->lock_count++;
+    void *ptr = do_realloc(entry->ptr, size);
+    entry->lock_count--;
+    if (!ptr) {
+        return 0;  // Out of memory
+    }
+    
+    ((memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t)))->handle = handle;
+    entry->ptr = ptr;
+    return 1;
+}
+
+// Resize a relocatable block; returns 1 on success, 0 if the old block
+// is left untouched
+int hrealloc(mem_handle_t handle, size_t size) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    int ok = do_hrealloc(handle, size);
+    if (ok) {
+        TRACE_ALLOC(handle_table[handle - 1].ptr, size);
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ok;
+}
+
+// Take a pin on a handle
+static void *do_hlock(mem_handle_t handle) {
+    memory_handle_t *entry = handle_entry(handle);
+    if (!entry) {
+        return NULL;
+    }
+    
+    entry->lock_count++;
+    return entry->ptr;
+}
+
+// Pin a relocatable block and return its current address
+void *hlock(mem_handle_t handle) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = do_hlock(handle);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+// Drop a pin, letting the compactor know once the block is movable
+static void do_hunlock(mem_handle_t handle) {
+    memory_handle_t *entry = handle_entry(handle);
+    if (!entry || entry->lock_count == 0) {
+        return;
+    }
+    
+    entry->lock_count--;
+    if (entry->lock_count == 0) {
+        compact_pending = 1;
+    }
+}
+
+// Unpin a relocatable block
+void hunlock(mem_handle_t handle) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    do_hunlock(handle);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+// Release a handle's block and its table slot
+static void do_hfree(mem_handle_t handle) {
+    memory_handle_t *entry = handle_entry(handle);
+    if (!entry) {
+        return;
     }
     
-    // Coalesce with previous block if it's free
-    if (memory_head != block) {
-        memory_block_t *prev = memory_head;
-        while (prev && prev->next != block) {
-            prev = prev->next;
+    do_free(entry->ptr);
+    entry->ptr = NULL;
+    entry->lock_count = 0;
+    mem_stats.handle_count--;
+}
+
+// Free a relocatable block and its handle
+void hfree(mem_handle_t handle) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    do_hfree(handle);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+// Returns 1 if the compactor may move this block
+static inline int block_is_movable(memory_block_t *block) {
+    return !block->is_free && block->handle && handle_table[block->handle - 1].lock_count == 0;
+}
+
+// One compaction pass within a byte budget
+static uint32_t do_compact(uint32_t max_bytes) {
+    if (!compact_pending) {
+        return 0;  // Nothing changed since the last full pass
+    }
+    
+    uint32_t moved_bytes = 0;
+    memory_block_t *block = memory_head;
+    
+    while (block) {
+        memory_block_t *next = block_next(block);
+        if (!block->is_free || !next || !block_is_movable(next)) {
+            block = next;
+            continue;
+        }
+        
+        if (moved_bytes >= max_bytes) {
+            return moved_bytes;  // Budget spent, resume on the next call
         }
         
-        if (prev && prev->is_free) {
-            prev->size += sizeof(memory_block_t) + block->size;
-            prev->next = block->next;
+        uint32_t gap = block->size + MEMORY_BLOCK_OVERHEAD;
+        uint32_t length = next->size + MEMORY_BLOCK_OVERHEAD;
+        mem_handle_t handle = next->handle;
+        
+        // Move the whole block (header, payload, guard) down into the gap
+        freelist_remove(block);
+        TRACE_MOVE(next, block);
+        memmove(block, next, length);
+        
+        memory_block_t *moved = block;
+        block_set_footer(moved);
+        handle_table[handle - 1].ptr = (uint8_t *)moved + sizeof(memory_block_t);
+        
+        // The gap reappears after the moved block
+        memory_block_t *hole = (memory_block_t *)((uint8_t *)moved + length);
+        hole->size = gap - MEMORY_BLOCK_OVERHEAD;
+        hole->is_free = 1;
+        hole->is_large = 0;
+        hole->handle = 0;
+        block_set_footer(hole);
+        
+        memory_block_t *after = block_next(hole);
+        if (after && after->is_free) {
+            freelist_remove(after);
+            hole->size += MEMORY_BLOCK_OVERHEAD + after->size;
+            block_set_footer(hole);
             mem_stats.block_count--;
+            mem_stats.free_memory += MEMORY_BLOCK_OVERHEAD;
+        }
+        freelist_insert(hole);
+        
+        moved_bytes += length;
+        mem_stats.compact_moves++;
+        mem_stats.compact_bytes += length;
+        block = hole;
+    }
+    
+    compact_pending = 0;
+    return moved_bytes;
+}
+
+// Slide unlocked relocatable blocks down over the free block in front of
+// them, so free space collects in fewer, larger blocks. Stops once
+// max_bytes have been moved; returns the bytes moved.
+uint32_t memory_compact(uint32_t max_bytes) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    uint32_t moved = do_compact(max_bytes);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return moved;
+}
+
+// Largest free block: the biggest entry in the highest non-empty class
+static uint32_t largest_free_block(void) {
+    if (!free_class_bitmap) {
+        return 0;
+    }
+    
+    uint32_t largest = 0;
+    memory_block_t *block = free_lists[31 - __builtin_clz(free_class_bitmap)];
+    while (block) {
+        if (block->size > largest) {
+            largest = block->size;
         }
+        block = block_links(block)->next;
     }
+    return largest;
 }
 
 // Get memory statistics
 void memory_get_stats(memory_stats_t *stats) {
     if (stats) {
+        uint32_t flags = spin_lock_irqsave(&heap_lock);
         *stats = mem_stats;
+        stats->largest_free_block = largest_free_block();
+        
+        // External fragmentation: share of free memory outside the largest free block
+        stats->fragmentation = 0;
+        if (mem_stats.free_memory > 0) {
+            stats->fragmentation = 100 - (stats->largest_free_block * 100) / mem_stats.free_memory;
+        }
+        spin_unlock_irqrestore(&heap_lock, flags);
+    }
+}
+
+// Print a byte count as B, KB or MB
+static void print_size(uint32_t size) {
+    char buffer[16];
+    
+    if (size >= 1048576 && (size & 1048575) == 0) {
+        itoa(size / 1048576, buffer);
+        console_puts(buffer);
+        console_puts("MB");
+    } else if (size >= 1024) {
+        itoa(size / 1024, buffer);
+        console_puts(buffer);
+        console_puts("KB");
+    } else {
+        itoa(size, buffer);
+        console_puts(buffer);
+        console_puts("B");
     }
 }
 
@@ -181,6 +1094,14 @@ void memory_print_stats(void) {
     console_puts(buffer);
     console_puts(" KB\n");
     
+    console_puts("Large Blocks:     ");
+    itoa(mem_stats.large_count, buffer);
+    console_puts(buffer);
+    console_puts(" (");
+    itoa(mem_stats.large_memory / 1024, buffer);
+    console_puts(buffer);
+    console_puts(" KB in pages)\n");
+    
     console_puts("Block Count:      ");
     itoa(mem_stats.block_count, buffer);
     console_puts(buffer);
@@ -196,30 +1117,193 @@ void memory_print_stats(void) {
     console_puts(buffer);
     console_puts("\n");
     
+    console_puts("Failed Allocs:    ");
+    itoa(mem_stats.failed_allocations, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Handles:          ");
+    itoa(mem_stats.handle_count, buffer);
+    console_puts(buffer);
+    console_puts(" (compactor moved ");
+    itoa(mem_stats.compact_moves, buffer);
+    console_puts(buffer);
+    console_puts(" blocks, ");
+    itoa(mem_stats.compact_bytes / 1024, buffer);
+    console_puts(buffer);
+    console_puts(" KB)\n");
+    
+    console_puts("Zero Pool:        ");
+    itoa(mem_stats.zero_pool_pages, buffer);
+    console_puts(buffer);
+    console_puts(" pages, ");
+    itoa(mem_stats.zero_pool_bytes, buffer);
+    console_puts(buffer);
+    console_puts(" bytes in blocks (");
+    itoa(mem_stats.zero_hits, buffer);
+    console_puts(buffer);
+    console_puts(" hits, ");
+    itoa(mem_stats.zero_misses, buffer);
+    console_puts(buffer);
+    console_puts(" misses)\n");
+    
+    console_puts("Peak Used:        ");
+    itoa(mem_stats.peak_used_memory / 1024, buffer);
+    console_puts(buffer);
+    console_puts(" KB\n");
+    
+    memory_stats_t current;
+    memory_get_stats(&current);
+    
+    console_puts("Largest Free:     ");
+    itoa(current.largest_free_block / 1024, buffer);
+    console_puts(buffer);
+    console_puts(" KB\n");
+    
+    console_puts("Fragmentation:    ");
+    itoa(current.fragmentation, buffer);
+    console_puts(buffer);
+    console_puts("%\n");
+    
     int usage_percent = (mem_stats.used_memory * 100) / mem_stats.total_memory;
     console_puts("Usage:            ");
     itoa(usage_percent, buffer);
     console_puts(buffer);
     console_puts("%\n");
-}
+    
+    console_puts("Heap Integrity:   ");
+    console_puts(memory_check_heap() ? "OK\n" : "CORRUPTED\n");
 
-// Initialize a memory region with a value
-void *memset(void *ptr, int value, size_t size) {
-    uint8_t *p = (uint8_t *)ptr;
-    for (size_t i = 0; i < size; i++) {
-        p[i] = (uint8_t)value;
+#ifdef MEMORY_RELEASE
+    console_puts("Allocator Mode:   release (no guards or bounds checks)\n");
+#else
+    console_puts("Allocator Mode:   debug (guard words, bounds checks)\n");
+#endif
+    console_puts("Overhead/Alloc:   ");
+    itoa(MEMORY_BLOCK_OVERHEAD + MEMORY_GUARD_SIZE, buffer);
+    console_puts(buffer);
+    console_puts(" bytes (header ");
+    itoa(sizeof(memory_block_t), buffer);
+    console_puts(buffer);
+    console_puts(" + footer ");
+    itoa(sizeof(memory_footer_t), buffer);
+    console_puts(buffer);
+    console_puts(" + guard ");
+    itoa(MEMORY_GUARD_SIZE, buffer);
+    console_puts(buffer);
+    console_puts(")\n");
+    
+    console_puts("\nSize Classes (block size, allocations, free blocks):\n");
+    for (uint32_t i = 0; i < MEMORY_CLASS_COUNT; i++) {
+        if (mem_stats.class_allocs[i] == 0 && mem_stats.class_free_blocks[i] == 0) {
+            continue;
+        }
+        
+        console_puts("  >=");
+        print_size(1u << (i + MEMORY_CLASS_MIN_SHIFT));
+        console_puts(" | Allocs: ");
+        itoa(mem_stats.class_allocs[i], buffer);
+        console_puts(buffer);
+        console_puts(" | Free: ");
+        itoa(mem_stats.class_free_blocks[i], buffer);
+        console_puts(buffer);
+        console_puts("\n");
+    }
+    
+    console_puts("\nRequest Sizes (log2 buckets, requests):\n");
+    for (uint32_t i = 0; i < MEMORY_HISTOGRAM_BUCKETS; i++) {
+        if (mem_stats.size_histogram[i] == 0) {
+            continue;
+        }
+        
+        console_puts("  >=");
+        print_size(1u << i);
+        console_puts(" | Requests: ");
+        itoa(mem_stats.size_histogram[i], buffer);
+        console_puts(buffer);
+        console_puts("\n");
     }
-    return ptr;
 }
 
-// Copy memory from source to destination
-void *memcpy(void *dest, const void *src, size_t size) {
-    uint8_t *d = (uint8_t *)dest;
-    const uint8_t *s = (const uint8_t *)src;
-    for (size_t i = 0; i < size; i++) {
-        d[i] = s[i];
+// Print a map of the pool, one cell per MEMORY_SIZE / (rows * columns) bytes:
+// '#' all used, '.' all free, '+' both
+void memory_print_heapmap(void) {
+    static uint8_t cells[MEMORY_MAP_ROWS * MEMORY_MAP_COLUMNS];
+    const uint32_t cell_count = MEMORY_MAP_ROWS * MEMORY_MAP_COLUMNS;
+    const uint32_t cell_size = MEMORY_SIZE / cell_count;
+    char buffer[16];
+    
+    for (uint32_t i = 0; i < cell_count; i++) {
+        cells[i] = 0;
+    }
+    
+    // Mark cells covered by each block (bit 0 used, bit 1 free) and count
+    // runs; the lock keeps other CPUs from splitting, merging or moving
+    // blocks under the walk
+    uint32_t used_runs = 0;
+    uint32_t free_runs = 0;
+    uint32_t largest_used_run = 0;
+    uint32_t current_used_run = 0;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    memory_block_t *block = memory_head;
+    
+    while (block) {
+        uint32_t start = (uint32_t)((uint8_t *)block - memory_pool);
+        uint32_t length = block->size + MEMORY_BLOCK_OVERHEAD;
+        uint8_t mark = block->is_free ? 2 : 1;
+        
+        for (uint32_t c = start / cell_size; c <= (start + length - 1) / cell_size; c++) {
+            cells[c] |= mark;
+        }
+        
+        if (block->is_free) {
+            free_runs++;
+            current_used_run = 0;
+        } else {
+            if (current_used_run == 0) {
+                used_runs++;
+            }
+            current_used_run += length;
+            if (current_used_run > largest_used_run) {
+                largest_used_run = current_used_run;
+            }
+        }
+        block = block_next(block);
+    }
+    spin_unlock_irqrestore(&heap_lock, flags);
+    
+    console_puts("\n=== Heap Map (");
+    print_size(cell_size);
+    console_puts(" per cell, # used . free + mixed) ===\n");
+    
+    for (uint32_t row = 0; row < MEMORY_MAP_ROWS; row++) {
+        char line[MEMORY_MAP_COLUMNS + 2];
+        for (uint32_t col = 0; col < MEMORY_MAP_COLUMNS; col++) {
+            uint8_t mark = cells[row * MEMORY_MAP_COLUMNS + col];
+            line[col] = (mark == 1) ? '#' : (mark == 2) ? '.' : '+';
+        }
+        line[MEMORY_MAP_COLUMNS] = '\n';
+        line[MEMORY_MAP_COLUMNS + 1] = '\0';
+        console_puts(line);
     }
-    return dest;
+    
+    memory_stats_t current;
+    memory_get_stats(&current);
+    
+    console_puts("Used Runs: ");
+    itoa(used_runs, buffer);
+    console_puts(buffer);
+    console_puts(" (largest ");
+    print_size(largest_used_run);
+    console_puts(") | Free Runs: ");
+    itoa(free_runs, buffer);
+    console_puts(buffer);
+    console_puts(" (largest ");
+    print_size(current.largest_free_block);
+    console_puts(") | Fragmentation: ");
+    itoa(current.fragmentation, buffer);
+    console_puts(buffer);
+    console_puts("%\n");
 }
 
 // Check if pointer is valid
@@ -233,28 +1317,88 @@ int memory_is_valid_ptr(void *ptr) {
     uint8_t *pool_start = memory_pool;
     uint8_t *pool_end = memory_pool + MEMORY_SIZE;
     
-    return (p >= pool_start && p < pool_end) ? 1 : 0;
+    if (p >= pool_start && p < pool_end) {
+        return 1;
+    }
+    
+    // Or the payload of a page-backed allocation
+    memory_block_t *block = (memory_block_t *)(p - sizeof(memory_block_t));
+    return (page_is_allocated(block) && block->is_large) ? 1 : 0;
 }
 
-// Check bounds for access
-int memory_check_bounds(void *ptr, size_t offset) {
-    if (!memory_is_valid_ptr(ptr)) {
+#ifndef MEMORY_RELEASE
+static int block_tags_valid(memory_block_t *block);
+
+// Check that bytes [ptr, ptr + offset] lie inside one live heap
+// allocation, in O(1): the block is found from its header in front of ptr
+static int do_check_bounds(void *ptr, size_t offset) {
+    if (!ptr) {
         return 0;
     }
     
-    // Get the block metadata
-    memory_block_t *block = (memory_block_t *)((uint8_t *)ptr - sizeof(memory_block_t));
+    uint8_t *p = (uint8_t *)ptr;
+    memory_block_t *block = (memory_block_t *)(p - sizeof(memory_block_t));
+    
+    if (p >= memory_pool && p < memory_pool + MEMORY_SIZE) {
+        // Only a payload start has its header right in front; finding
+        // the block around an interior pointer would mean walking the
+        // pool, so those are accepted like non-heap pointers
+        if ((uint8_t *)block < memory_pool || block->guard_start != MEMORY_GUARD_BYTE ||
+            !block_tags_valid(block)) {
+            return 1;
+        }
+        if (block->is_free) {
+            return 0;  // Freed block
+        }
+    } else if (!page_is_allocated(block) || !block->is_large) {
+        return 1;  // Not heap memory
+    }
     
     // Check if access would exceed capacity
-    if (offset > block->capacity) {
+    uint8_t *payload = (uint8_t *)block + sizeof(memory_block_t);
+    if (p < payload || (uint32_t)(p - payload) >= block->capacity ||
+        offset >= block->capacity - (uint32_t)(p - payload)) {
         return 0;  // Out of bounds
     }
     
     return 1;
 }
 
+// Pointers outside the heap (stack or static buffers) cannot be checked
+// and are accepted
+int memory_check_bounds(void *ptr, size_t offset) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    int ok = do_check_bounds(ptr, offset);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ok;
+}
+#endif
+
+// Check that a block's boundary tags agree with its neighbours
+static int block_tags_valid(memory_block_t *block) {
+    uint8_t *pool_end = memory_pool + MEMORY_SIZE;
+    
+    if ((uint8_t *)block < memory_pool ||
+        (uint8_t *)block + MEMORY_BLOCK_OVERHEAD > pool_end ||
+        block->size > (uint32_t)(pool_end - (uint8_t *)block) - MEMORY_BLOCK_OVERHEAD) {
+        return 0;  // Header size runs off the pool
+    }
+    
+    if (block_footer(block)->header != block) {
+        return 0;  // Footer disagrees with header
+    }
+    
+    memory_block_t *prev = block_prev(block);
+    if (prev && ((uint8_t *)prev < memory_pool || prev >= block || block_next(prev) != block)) {
+        return 0;  // Previous block's footer is stale
+    }
+    
+    return 1;
+}
+
+#ifndef MEMORY_RELEASE
 // Check guard bytes for buffer overflow detection
-int memory_check_guard(void *ptr) {
+static int do_check_guard(void *ptr) {
     if (!memory_is_valid_ptr(ptr)) {
         return 0;
     }
@@ -273,5 +1417,156 @@ int memory_check_guard(void *ptr) {
         return 0;  // Guard corrupted
     }
     
+    // Check the block's boundary tags (page-backed blocks have none)
+    if (!block->is_large && !block_tags_valid(block)) {
+        return 0;  // Header/footer mismatch
+    }
+    
     return 1;
 }
+
+// Check a block's guards with no other CPU changing the heap meanwhile
+int memory_check_guard(void *ptr) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    int ok = do_check_guard(ptr);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ok;
+}
+#endif
+
+// Verify every block's tags and the free-list accounting
+static int check_heap(void) {
+    memory_block_t *block = memory_head;
+    uint32_t blocks = 0;
+    uint32_t free_bytes = 0;
+    int prev_free = 0;
+    
+    while (block) {
+        if (!block_tags_valid(block)) {
+            return 0;  // Header/footer mismatch
+        }
+        
+        if (block->is_free) {
+            if (prev_free) {
+                return 0;  // Two adjacent free blocks escaped coalescing
+            }
+            free_bytes += block->size;
+        }
+#ifndef MEMORY_RELEASE
+        else if (!do_check_guard((uint8_t *)block + sizeof(memory_block_t))) {
+            return 0;  // Guard corrupted
+        }
+#endif
+        
+        prev_free = block->is_free;
+        blocks++;
+        block = block_next(block);
+    }
+    
+    return (blocks == mem_stats.block_count && free_bytes == mem_stats.free_memory) ? 1 : 0;
+}
+
+// Walk the whole heap and verify every header against its footer
+int memory_check_heap(void) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    int ok = check_heap();
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ok;
+}
+
+// Print live allocations grouped by call site, largest owners first
+void memory_print_leaks(void) {
+#ifdef MEMORY_TRACE
+    static void *site_caller[MEMORY_TRACE_SITES];
+    static uint32_t site_blocks[MEMORY_TRACE_SITES];
+    static uint32_t site_bytes[MEMORY_TRACE_SITES];
+    static uint32_t site_oldest[MEMORY_TRACE_SITES];
+    static uint8_t site_printed[MEMORY_TRACE_SITES];
+    uint32_t site_count = 0;
+    uint32_t live = 0;
+    uint32_t unlisted_blocks = 0;
+    char buffer[16];
+    
+    // Group trace entries by caller, with the table held still
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    for (uint32_t i = 0; i < MEMORY_TRACE_ENTRIES; i++) {
+        memory_trace_t *entry = &trace_table[i];
+        if (!entry->block) {
+            continue;
+        }
+        live++;
+        
+        uint32_t s = 0;
+        while (s < site_count && site_caller[s] != entry->caller) {
+            s++;
+        }
+        if (s == site_count) {
+            if (site_count == MEMORY_TRACE_SITES) {
+                unlisted_blocks++;
+                continue;  // Too many distinct sites to list
+            }
+            site_caller[s] = entry->caller;
+            site_blocks[s] = 0;
+            site_bytes[s] = 0;
+            site_oldest[s] = entry->tick;
+            site_printed[s] = 0;
+            site_count++;
+        }
+        
+        site_blocks[s]++;
+        site_bytes[s] += entry->size;
+        if (entry->tick < site_oldest[s]) {
+            site_oldest[s] = entry->tick;
+        }
+    }
+    uint32_t dropped = trace_dropped;
+    spin_unlock_irqrestore(&heap_lock, flags);
+    
+    console_puts("\n=== Live Allocations by Call Site ===\n");
+    
+    for (uint32_t n = 0; n < site_count; n++) {
+        // Pick the unprinted site holding the most bytes
+        uint32_t best = 0;
+        int found = 0;
+        for (uint32_t s = 0; s < site_count; s++) {
+            if (!site_printed[s] && (!found || site_bytes[s] > site_bytes[best])) {
+                best = s;
+                found = 1;
+            }
+        }
+        site_printed[best] = 1;
+        
+        itoa_hex((uint32_t)(uintptr_t)site_caller[best], buffer);
+        console_puts(buffer);
+        console_puts(" | Blocks: ");
+        itoa(site_blocks[best], buffer);
+        console_puts(buffer);
+        console_puts(" | Bytes: ");
+        itoa(site_bytes[best], buffer);
+        console_puts(buffer);
+        console_puts(" | Oldest Tick: ");
+        itoa(site_oldest[best], buffer);
+        console_puts(buffer);
+        console_puts("\n");
+    }
+    
+    console_puts("Live Tracked: ");
+    itoa(live, buffer);
+    console_puts(buffer);
+    console_puts(" | Sites: ");
+    itoa(site_count, buffer);
+    console_puts(buffer);
+    if (unlisted_blocks > 0) {
+        console_puts(" (+");
+        itoa(unlisted_blocks, buffer);
+        console_puts(buffer);
+        console_puts(" blocks from unlisted sites)");
+    }
+    console_puts(" | Untracked (table full): ");
+    itoa(dropped, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+#else
+    console_puts("Allocation tracing is disabled (rebuild with MEMORY_TRACE=1)\n");
+#endif
+}
@@ -3,24 +3,105 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "memops.h"
 
 // Memory management constants
 #define MEMORY_START 0x100000      // Start of heap at 1MB
 #define MEMORY_SIZE 0x100000       // 1MB of heap memory
 #define MEMORY_BLOCK_SIZE 16       // Minimum allocation size (bytes)
 #define MEMORY_GUARD_BYTE 0xDEADBEEF  // Guard pattern for detecting overflow
+#ifdef MEMORY_RELEASE
+#define MEMORY_GUARD_SIZE 0        // Release builds carry no guard words
+#else
 #define MEMORY_GUARD_SIZE 4        // Size of guard bytes
+#endif
+#define MEMORY_ALIGN 8             // Allocation sizes are rounded to this
+#define MEMORY_LARGE_THRESHOLD 16384  // Larger requests go to the page allocator
+
+// Segregated free lists: class N holds free blocks of [2^(N+4), 2^(N+5)) bytes
+#define MEMORY_CLASS_MIN_SHIFT 4
+#define MEMORY_CLASS_COUNT 17      // 16 bytes .. 1MB
+
+// Request-size histogram: bucket N counts requests of [2^N, 2^(N+1)) bytes
+#define MEMORY_HISTOGRAM_BUCKETS 23  // 1 byte .. 4MB
+
+// Heap map layout for /heapmap
+#define MEMORY_MAP_COLUMNS 64
+#define MEMORY_MAP_ROWS 8
+
+// Allocation call-site tracing (build with MEMORY_TRACE=1)
+#define MEMORY_TRACE_ENTRIES 512   // Live allocations that can be tracked
+#define MEMORY_TRACE_SITES 32      // Distinct call sites in a /leaks report
+#define MEMORY_TRACE_NONE 0xFFFF   // Block has no trace table entry
+
+// Relocatable (handle-based) allocations
+#define MEMORY_HANDLE_MAX 64       // Live handles
+#define MEMORY_COMPACT_STEP 16384  // Bytes the idle-time compactor moves per call
+
+// Pre-zeroed pools kept topped up by the idle loop
+#define MEMORY_ZERO_PAGES 16       // Zeroed page frames held for kzalloc_page()
+#define MEMORY_ZERO_BLOCKS 4       // Zeroed blocks held per pool size
+#define MEMORY_ZERO_MIN_SHIFT 5    // Pool block sizes: 32 bytes ..
+#define MEMORY_ZERO_CLASSES 7      // .. 2KB; larger kzalloc() requests zero inline
+#define MEMORY_ZERO_STEP 4096      // Bytes the idle-time worker zeroes per call
+
+struct memory_block;
+
+// Size-class free list links of a free block
+typedef struct {
+    struct memory_block *next;     // Next block in the same size-class free list
+    struct memory_block *prev;     // Previous block in the same size-class free list
+} memory_free_links_t;
 
 // Memory block metadata structure
+// Each block is laid out as [memory_block_t][payload + guard][memory_footer_t],
+// so both physical neighbours can be reached in O(1) from any block.
+// Debug builds (the default) keep capacity, guard words and free-list links
+// in the header; release builds (MEMORY_RELEASE) keep only size and flags
+// and store the links in the payload of free blocks.
 typedef struct memory_block {
     uint32_t size;                 // Actual allocated size (including capacity info)
+#ifndef MEMORY_RELEASE
     uint32_t capacity;             // Usable capacity
     uint32_t used;                 // Currently used bytes in this block
+#endif
     uint8_t is_free;              // 1 if free, 0 if allocated
+    uint8_t is_large;             // 1 if backed by whole pages from the page allocator
+    uint16_t handle;              // Owning handle for relocatable blocks, 0 otherwise
+#ifdef MEMORY_TRACE
+    uint16_t trace_slot;          // Index into the trace table, or MEMORY_TRACE_NONE
+#endif
+#ifndef MEMORY_RELEASE
     uint32_t guard_start;          // Guard bytes at start (0xDEADBEEF)
-    struct memory_block *next;    // Pointer to next block
+    memory_free_links_t links;     // Free-list links (valid while free)
+#endif
 } memory_block_t;
 
+// Boundary tag stored at the end of every block
+typedef struct {
+    memory_block_t *header;        // Back-pointer to the owning block header
+} memory_footer_t;
+
+// Per-block metadata overhead (header + footer)
+#define MEMORY_BLOCK_OVERHEAD (sizeof(memory_block_t) + sizeof(memory_footer_t))
+
+// Trace table entry for one live allocation
+typedef struct {
+    memory_block_t *block;         // Traced block, NULL if the slot is free
+    void *caller;                  // Return address of the allocating call
+    uint32_t size;                 // Requested size
+    uint32_t tick;                 // Scheduler tick at allocation time
+} memory_trace_t;
+
+// Handle to a relocatable allocation (0 is never valid)
+typedef uint32_t mem_handle_t;
+
+// Handle table entry
+typedef struct {
+    void *ptr;                     // Current payload address, NULL if the slot is free
+    uint32_t lock_count;           // Block may only move while this is 0
+} memory_handle_t;
+
 // Memory management statistics
 typedef struct {
     uint32_t total_memory;        // Total memory available
@@ -29,6 +110,22 @@ typedef struct {
     uint32_t block_count;         // Number of memory blocks
     uint32_t allocation_count;    // Number of allocations
     uint32_t free_count;          // Number of frees
+    uint32_t large_count;         // Live page-backed allocations
+    uint32_t large_memory;        // Bytes held by page-backed allocations
+    uint32_t peak_used_memory;    // High-water mark of pool + page-backed usage
+    uint32_t failed_allocations;  // Requests that could not be satisfied
+    uint32_t handle_count;        // Live relocatable allocations
+    uint32_t compact_moves;       // Blocks moved by the compactor
+    uint32_t compact_bytes;       // Bytes moved by the compactor
+    uint32_t zero_pool_pages;     // Pre-zeroed page frames held
+    uint32_t zero_pool_bytes;     // Pool bytes held in pre-zeroed blocks
+    uint32_t zero_hits;           // kzalloc()/kzalloc_page() calls served pre-zeroed
+    uint32_t zero_misses;         // Calls that had to zero on the allocation path
+    uint32_t largest_free_block;  // Largest free pool block (filled in by memory_get_stats)
+    uint32_t fragmentation;       // External fragmentation in percent (filled in by memory_get_stats)
+    uint32_t size_histogram[MEMORY_HISTOGRAM_BUCKETS];  // Requested sizes, log2 buckets
+    uint32_t class_allocs[MEMORY_CLASS_COUNT];       // Allocations served per size class
+    uint32_t class_free_blocks[MEMORY_CLASS_COUNT];  // Free blocks currently in each class
 } memory_stats_t;
 
 // Initialize memory management system
@@ -37,24 +134,67 @@ void memory_init(void);
 // Allocate memory (malloc-like)
 void *malloc(size_t size);
 
+// Allocate memory whose payload is aligned to a power-of-two boundary
+void *memalign(size_t alignment, size_t size);
+
+// Allocate zero-initialized memory (calloc-like)
+void *calloc(size_t count, size_t size);
+
+// Allocate zeroed memory, from the pre-zeroed pool when possible
+void *kzalloc(size_t size);
+
+// Allocate one zeroed page frame (release with free_pages(addr, 0))
+void *kzalloc_page(void);
+
+// Top up the pre-zeroed pools; returns bytes zeroed
+uint32_t memory_zero_refill(uint32_t max_bytes);
+
+// Resize an allocation, in place when possible (realloc-like)
+void *realloc(void *ptr, size_t size);
+
 // Free memory (free-like)
 void free(void *ptr);
 
+// Relocatable allocations: a block may be moved by the compactor whenever
+// it is not locked, so its address is only valid between hlock/hunlock
+mem_handle_t halloc(size_t size);
+int hrealloc(mem_handle_t handle, size_t size);
+void *hlock(mem_handle_t handle);
+void hunlock(mem_handle_t handle);
+void hfree(mem_handle_t handle);
+
+// Slide unlocked relocatable blocks down over free space; returns bytes moved
+uint32_t memory_compact(uint32_t max_bytes);
+
 // Get memory statistics
 void memory_get_stats(memory_stats_t *stats);
 
 // Print memory statistics to console
 void memory_print_stats(void);
 
-// Initialize a memory region with a value
-void *memset(void *ptr, int value, size_t size);
-
-// Copy memory from source to destination
-void *memcpy(void *dest, const void *src, size_t size);
+// Print a map of used and free runs in the pool
+void memory_print_heapmap(void);
 
 // Safety functions
 int memory_is_valid_ptr(void *ptr);
+int memory_check_heap(void);
+
+#ifdef MEMORY_RELEASE
+// Release builds have no guard words or capacity to check against
+static inline int memory_check_bounds(void *ptr, size_t offset) {
+    (void)offset;
+    return ptr != NULL;
+}
+
+static inline int memory_check_guard(void *ptr) {
+    return ptr != NULL;
+}
+#else
 int memory_check_bounds(void *ptr, size_t offset);
 int memory_check_guard(void *ptr);
+#endif
+
+// Print live allocations grouped by call site (needs MEMORY_TRACE)
+void memory_print_leaks(void);
 
 #endif // MEMORY_H
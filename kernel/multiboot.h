@@ -0,0 +1,84 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Multiboot2 constants
+#define MULTIBOOT2_BOOTLOADER_MAGIC 0x36d76289
+
+// Tag types
+#define MULTIBOOT_TAG_TYPE_END 0
+#define MULTIBOOT_TAG_TYPE_CMDLINE 1
+#define MULTIBOOT_TAG_TYPE_MMAP 6
+
+// Memory map entry types
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+// Boot information header
+typedef struct {
+    uint32_t total_size;        // Size of the whole info structure
+    uint32_t reserved;
+} __attribute__((packed)) multiboot_info_t;
+
+// Generic tag header
+typedef struct {
+    uint32_t type;              // Tag type
+    uint32_t size;              // Tag size (without padding)
+} __attribute__((packed)) multiboot_tag_t;
+
+// Memory map entry
+typedef struct {
+    uint64_t addr;              // Region start address
+    uint64_t len;               // Region length
+    uint32_t type;              // Region type
+    uint32_t zero;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+// Memory map tag
+typedef struct {
+    uint32_t type;              // MULTIBOOT_TAG_TYPE_MMAP
+    uint32_t size;              // Tag size
+    uint32_t entry_size;        // Size of one entry
+    uint32_t entry_version;
+    multiboot_mmap_entry_t entries[];
+} __attribute__((packed)) multiboot_tag_mmap_t;
+
+// Boot command line tag
+typedef struct {
+    uint32_t type;              // MULTIBOOT_TAG_TYPE_CMDLINE
+    uint32_t size;              // Tag size
+    char string[];              // NUL-terminated
+} __attribute__((packed)) multiboot_tag_string_t;
+
+// Find the first tag of a given type, or NULL
+static inline multiboot_tag_t *multiboot_find_tag(multiboot_info_t *info, uint32_t type) {
+    if (!info) {
+        return NULL;
+    }
+    
+    uint8_t *ptr = (uint8_t *)info + sizeof(multiboot_info_t);
+    uint8_t *end = (uint8_t *)info + info->total_size;
+    
+    while (ptr + sizeof(multiboot_tag_t) <= end) {
+        multiboot_tag_t *tag = (multiboot_tag_t *)ptr;
+        if (tag->type == MULTIBOOT_TAG_TYPE_END) {
+            break;
+        }
+        if (tag->type == type) {
+            return tag;
+        }
+        // Tags are padded to 8-byte boundaries
+        ptr += (tag->size + 7) & ~7u;
+    }
+    
+    return NULL;
+}
+
+// Kernel command line, or NULL
+static inline const char *multiboot_cmdline(multiboot_info_t *info) {
+    multiboot_tag_string_t *tag = (multiboot_tag_string_t *)multiboot_find_tag(info, MULTIBOOT_TAG_TYPE_CMDLINE);
+    return tag ? tag->string : NULL;
+}
+
+#endif // MULTIBOOT_H
@@ -0,0 +1,409 @@
+#include "page.h"
+#include "cpu.h"
+#include "spinlock.h"
+
+// Kernel image bounds (from linker.ld)
+extern uint8_t kernel_start[];
+extern uint8_t kernel_end[];
+
+// Frame metadata, indexed by physical frame number
+static page_t *mem_map = NULL;
+static uint32_t mem_map_pages = 0;
+
+// Buddy free lists, one per order
+static page_t *free_areas[PAGE_MAX_ORDER + 1];
+
+// Page allocator statistics
+static page_stats_t page_stats = {0};
+
+// Guards the free lists, frame metadata and statistics across CPUs
+static spinlock_t page_lock = SPINLOCK_INIT;
+
+// Address ranges that must never be handed out
+#define MAX_RESERVED_RANGES 4
+static uint32_t reserved_start[MAX_RESERVED_RANGES];
+static uint32_t reserved_end[MAX_RESERVED_RANGES];
+static uint32_t reserved_count = 0;
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+
+// Frame number of a metadata entry
+static inline uint32_t page_to_pfn(page_t *page) {
+    return (uint32_t)(page - mem_map);
+}
+
+// Push a block head onto its order's free list
+static void free_area_push(page_t *page, uint32_t order) {
+    page->flags = PAGE_FREE;
+    page->order = order;
+    page->prev = NULL;
+    page->next = free_areas[order];
+    if (free_areas[order]) {
+        free_areas[order]->prev = page;
+    }
+    free_areas[order] = page;
+    page_stats.free_blocks[order]++;
+}
+
+// Unlink a block head from its order's free list
+static void free_area_remove(page_t *page, uint32_t order) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        free_areas[order] = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->next = NULL;
+    page->prev = NULL;
+    page->flags = 0;
+    page_stats.free_blocks[order]--;
+}
+
+// Return a block to the free lists, merging with free buddies
+static void buddy_free(uint32_t pfn, uint32_t order) {
+    while (order < PAGE_MAX_ORDER) {
+        uint32_t buddy_pfn = pfn ^ (1u << order);
+        if (buddy_pfn >= mem_map_pages) {
+            break;
+        }
+        
+        page_t *buddy = &mem_map[buddy_pfn];
+        if (!(buddy->flags & PAGE_FREE) || buddy->order != order) {
+            break;  // Buddy is in use, reserved or split
+        }
+        
+        free_area_remove(buddy, order);
+        pfn &= ~(1u << order);
+        order++;
+    }
+    
+    free_area_push(&mem_map[pfn], order);
+}
+
+// Check whether an address falls in a reserved range
+static int is_reserved(uint32_t addr) {
+    for (uint32_t i = 0; i < reserved_count; i++) {
+        if (addr >= reserved_start[i] && addr < reserved_end[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Record a range the allocator must not hand out
+static void reserve_range(uint32_t start, uint32_t end) {
+    if (reserved_count < MAX_RESERVED_RANGES) {
+        reserved_start[reserved_count] = start & ~(PAGE_SIZE - 1);
+        reserved_end[reserved_count] = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        reserved_count++;
+    }
+}
+
+// Clip a memory map entry to the identity-mapped physical range
+static int region_bounds(multiboot_mmap_entry_t *entry, uint32_t *start, uint32_t *end) {
+    if (entry->type != MULTIBOOT_MEMORY_AVAILABLE || entry->addr >= PAGE_PHYS_LIMIT) {
+        return 0;
+    }
+    
+    uint64_t region_end = entry->addr + entry->len;
+    if (region_end > PAGE_PHYS_LIMIT) {
+        region_end = PAGE_PHYS_LIMIT;
+    }
+    
+    *start = ((uint32_t)entry->addr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    *end = (uint32_t)region_end & ~(PAGE_SIZE - 1);
+    return *start < *end;
+}
+
+// Find room for the frame metadata in an available region
+static uint32_t place_mem_map(multiboot_tag_mmap_t *mmap, uint32_t bytes, uint32_t mbi_start, uint32_t mbi_end) {
+    uint32_t kernel_limit = ((uint32_t)kernel_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint8_t *ptr = (uint8_t *)mmap->entries;
+    uint8_t *end = (uint8_t *)mmap + mmap->size;
+    
+    for (; ptr < end; ptr += mmap->entry_size) {
+        uint32_t start, region_end;
+        if (!region_bounds((multiboot_mmap_entry_t *)ptr, &start, &region_end)) {
+            continue;
+        }
+        
+        if (start < kernel_limit) {
+            start = kernel_limit;
+        }
+        if (start < mbi_end && start + bytes > mbi_start) {
+            start = (mbi_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        }
+        
+        if (start < region_end && region_end - start >= bytes) {
+            return start;
+        }
+    }
+    
+    return 0;
+}
+
+// Initialize the page-frame allocator from the multiboot2 memory map
+void page_alloc_init(uint32_t magic, multiboot_info_t *info) {
+    for (uint32_t i = 0; i <= PAGE_MAX_ORDER; i++) {
+        free_areas[i] = NULL;
+        page_stats.free_blocks[i] = 0;
+    }
+    page_stats.total_pages = 0;
+    page_stats.free_pages = 0;
+    page_stats.alloc_count = 0;
+    page_stats.free_count = 0;
+    
+    if (magic != MULTIBOOT2_BOOTLOADER_MAGIC) {
+        return;  // No memory map to work from
+    }
+    
+    multiboot_tag_mmap_t *mmap = (multiboot_tag_mmap_t *)multiboot_find_tag(info, MULTIBOOT_TAG_TYPE_MMAP);
+    if (!mmap) {
+        return;
+    }
+    
+    // Highest usable address decides how many frames need metadata
+    uint32_t max_addr = 0;
+    uint8_t *ptr;
+    uint8_t *end = (uint8_t *)mmap + mmap->size;
+    for (ptr = (uint8_t *)mmap->entries; ptr < end; ptr += mmap->entry_size) {
+        uint32_t start, region_end;
+        if (region_bounds((multiboot_mmap_entry_t *)ptr, &start, &region_end) && region_end > max_addr) {
+            max_addr = region_end;
+        }
+    }
+    
+    mem_map_pages = max_addr >> PAGE_SHIFT;
+    uint32_t map_bytes = mem_map_pages * sizeof(page_t);
+    uint32_t mbi_start = (uint32_t)info;
+    uint32_t mbi_end = mbi_start + info->total_size;
+    
+    uint32_t map_addr = place_mem_map(mmap, map_bytes, mbi_start, mbi_end);
+    if (!map_addr) {
+        mem_map_pages = 0;
+        return;  // Nowhere to keep the metadata
+    }
+    mem_map = (page_t *)map_addr;
+    
+    // Low memory, the kernel image, the boot info and the metadata stay reserved
+    reserved_count = 0;
+    reserve_range(0, 0x100000);
+    reserve_range((uint32_t)kernel_start, (uint32_t)kernel_end);
+    reserve_range(mbi_start, mbi_end);
+    reserve_range(map_addr, map_addr + map_bytes);
+    
+    for (uint32_t pfn = 0; pfn < mem_map_pages; pfn++) {
+        mem_map[pfn].next = NULL;
+        mem_map[pfn].prev = NULL;
+        mem_map[pfn].order = 0;
+        mem_map[pfn].flags = PAGE_RESERVED;
+        mem_map[pfn].refcount = 0;
+    }
+    
+    // Hand every usable frame to the buddy allocator
+    for (ptr = (uint8_t *)mmap->entries; ptr < end; ptr += mmap->entry_size) {
+        uint32_t start, region_end;
+        if (!region_bounds((multiboot_mmap_entry_t *)ptr, &start, &region_end)) {
+            continue;
+        }
+        
+        for (uint32_t addr = start; addr < region_end; addr += PAGE_SIZE) {
+            if (is_reserved(addr)) {
+                continue;
+            }
+            mem_map[addr >> PAGE_SHIFT].flags = 0;
+            buddy_free(addr >> PAGE_SHIFT, 0);
+            page_stats.total_pages++;
+            page_stats.free_pages++;
+        }
+    }
+}
+
+// Take a 2^order block off the free lists, splitting larger blocks
+static void *buddy_alloc(uint32_t order) {
+    // Smallest order with a free block
+    uint32_t current = order;
+    while (current <= PAGE_MAX_ORDER && !free_areas[current]) {
+        current++;
+    }
+    if (current > PAGE_MAX_ORDER) {
+        return NULL;  // Out of memory
+    }
+    
+    page_t *page = free_areas[current];
+    free_area_remove(page, current);
+    
+    // Split down, returning the upper halves to the free lists
+    while (current > order) {
+        current--;
+        free_area_push(page + (1u << current), current);
+    }
+    
+    page->flags = PAGE_ALLOCATED;
+    page->order = order;
+    page->refcount = 1;
+    
+    page_stats.free_pages -= (1u << order);
+    page_stats.alloc_count++;
+    
+    return (void *)(page_to_pfn(page) << PAGE_SHIFT);
+}
+
+// Allocate 2^order contiguous frames
+void *alloc_pages(uint32_t order) {
+    if (order > PAGE_MAX_ORDER) {
+        return NULL;
+    }
+    
+    // Threads can be preempted mid-allocation, and other CPUs allocate
+    // concurrently; keep the free lists consistent
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    void *addr = buddy_alloc(order);
+    spin_unlock_irqrestore(&page_lock, flags);
+    return addr;
+}
+
+// Return an allocated block to the buddy lists (page_lock held)
+static void do_free_pages(void *addr, uint32_t order) {
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+    
+    if (!addr || ((uint32_t)addr & (PAGE_SIZE - 1)) || pfn >= mem_map_pages) {
+        return;  // Not a managed frame
+    }
+    
+    page_t *page = &mem_map[pfn];
+    if ((page->flags & PAGE_ALLOCATED) && page->order == order) {
+        page->flags = 0;
+        page->refcount = 0;
+        buddy_free(pfn, order);
+        
+        page_stats.free_pages += (1u << order);
+        page_stats.free_count++;
+    }
+}
+
+// Free a block previously returned by alloc_pages()
+void free_pages(void *addr, uint32_t order) {
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    do_free_pages(addr, order);
+    spin_unlock_irqrestore(&page_lock, flags);
+}
+
+// Smallest order whose block holds `size` bytes
+uint32_t page_order_for_size(size_t size) {
+    uint32_t order = 0;
+    while (order <= PAGE_MAX_ORDER && ((size_t)PAGE_SIZE << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+// Check whether an address is the start of an allocated block
+int page_is_allocated(void *addr) {
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+    
+    if (((uint32_t)addr & (PAGE_SIZE - 1)) || pfn >= mem_map_pages) {
+        return 0;
+    }
+    
+    return (mem_map[pfn].flags & PAGE_ALLOCATED) ? 1 : 0;
+}
+
+// Metadata of an allocated block head, or NULL
+static page_t *allocated_page(void *addr) {
+    uint32_t pfn = (uint32_t)addr >> PAGE_SHIFT;
+    
+    if (((uint32_t)addr & (PAGE_SIZE - 1)) || pfn >= mem_map_pages) {
+        return NULL;
+    }
+    
+    return (mem_map[pfn].flags & PAGE_ALLOCATED) ? &mem_map[pfn] : NULL;
+}
+
+// Take another reference to an allocated block
+void page_get(void *addr) {
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    page_t *page = allocated_page(addr);
+    if (page) {
+        page->refcount++;
+    }
+    spin_unlock_irqrestore(&page_lock, flags);
+}
+
+// Drop a reference to an allocated block, freeing it with the last one.
+// Returns 1 if the block was freed.
+int page_put(void *addr, uint32_t order) {
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    page_t *page = allocated_page(addr);
+    int freed = 0;
+    
+    if (page && page->refcount > 1) {
+        page->refcount--;
+    } else if (page) {
+        do_free_pages(addr, order);
+        freed = 1;
+    }
+    spin_unlock_irqrestore(&page_lock, flags);
+    return freed;
+}
+
+// References held on an allocated block (0 if not allocated)
+uint32_t page_refcount(void *addr) {
+    page_t *page = allocated_page(addr);
+    return page ? page->refcount : 0;
+}
+
+// Get page allocator statistics
+void page_get_stats(page_stats_t *stats) {
+    if (stats) {
+        *stats = page_stats;
+    }
+}
+
+// Print page allocator statistics
+void page_print_stats(void) {
+    char buffer[64];
+    
+    console_puts("\n=== Page Frame Allocator ===\n");
+    
+    console_puts("Total Frames:     ");
+    itoa(page_stats.total_pages, buffer);
+    console_puts(buffer);
+    console_puts(" (");
+    itoa(page_stats.total_pages / 256, buffer);
+    console_puts(buffer);
+    console_puts(" MB)\n");
+    
+    console_puts("Free Frames:      ");
+    itoa(page_stats.free_pages, buffer);
+    console_puts(buffer);
+    console_puts(" (");
+    itoa(page_stats.free_pages / 256, buffer);
+    console_puts(buffer);
+    console_puts(" MB)\n");
+    
+    console_puts("Allocations:      ");
+    itoa(page_stats.alloc_count, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Frees:            ");
+    itoa(page_stats.free_count, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Free blocks by order:\n");
+    for (uint32_t i = 0; i <= PAGE_MAX_ORDER; i++) {
+        console_puts("  ");
+        itoa(i, buffer);
+        console_puts(buffer);
+        console_puts(": ");
+        itoa(page_stats.free_blocks[i], buffer);
+        console_puts(buffer);
+        console_puts((i % 4 == 3 || i == PAGE_MAX_ORDER) ? "\n" : "\t");
+    }
+}
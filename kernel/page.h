@@ -0,0 +1,61 @@
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "multiboot.h"
+
+// Page frame constants
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define PAGE_MAX_ORDER 10          // Largest buddy block: 2^10 pages (4MB)
+#define PAGE_PHYS_LIMIT 0xC0000000 // Frames must stay inside the kernel identity map
+
+// Page frame flags
+#define PAGE_RESERVED 0x01         // Not managed (hole, kernel image, metadata)
+#define PAGE_FREE 0x02             // Head of a free buddy block
+#define PAGE_ALLOCATED 0x04        // Head of an allocated buddy block
+
+// Per-frame metadata
+typedef struct page {
+    struct page *next;             // Next block in the free list
+    struct page *prev;             // Previous block in the free list
+    uint8_t order;                 // Block order (valid on block heads)
+    uint8_t flags;                 // PAGE_* flags
+    uint16_t refcount;             // References to an allocated block
+} page_t;
+
+// Page allocator statistics
+typedef struct {
+    uint32_t total_pages;          // Usable frames under buddy management
+    uint32_t free_pages;           // Frames currently free
+    uint32_t free_blocks[PAGE_MAX_ORDER + 1];  // Free blocks per order
+    uint32_t alloc_count;          // Number of alloc_pages() calls served
+    uint32_t free_count;           // Number of free_pages() calls
+} page_stats_t;
+
+// Initialize the page-frame allocator from the multiboot2 memory map
+void page_alloc_init(uint32_t magic, multiboot_info_t *info);
+
+// Allocate 2^order contiguous, naturally aligned frames
+void *alloc_pages(uint32_t order);
+
+// Free a block previously returned by alloc_pages()
+void free_pages(void *addr, uint32_t order);
+
+// Smallest order whose block holds `size` bytes
+uint32_t page_order_for_size(size_t size);
+
+// Check whether an address is the start of an allocated block
+int page_is_allocated(void *addr);
+
+// Reference counting for blocks shared between address spaces
+void page_get(void *addr);
+int page_put(void *addr, uint32_t order);
+uint32_t page_refcount(void *addr);
+
+// Statistics
+void page_get_stats(page_stats_t *stats);
+void page_print_stats(void);
+
+#endif // PAGE_H
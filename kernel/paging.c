@@ -0,0 +1,414 @@
+#include "paging.h"
+#include "memory.h"
+#include "slab.h"
+#include "cpu.h"
+#include "spinlock.h"
+#include "smp.h"
+
+// Kernel page directory: 4MB identity mappings of all managed frames
+static uint32_t kernel_page_directory[PAGING_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+// Serializes page table updates: fault handling on any CPU, fork and
+// teardown. The address space each CPU has loaded is cpu_t.space.
+static spinlock_t paging_lock = SPINLOCK_INIT;
+
+// Object cache for address_space_t
+static kmem_cache_t *space_cache = NULL;
+
+// Frame sharing statistics
+static paging_stats_t paging_stats = {0};
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+void itoa_hex(uint32_t num, char *str);
+
+// Initialize paging with the kernel identity map and enable it
+void paging_init(void) {
+    for (uint32_t i = 0; i < PAGING_ENTRIES; i++) {
+        if (i < PAGING_KERNEL_PDES) {
+            kernel_page_directory[i] = (i * PAGING_LARGE_PAGE_SIZE) | PTE_LARGE | PTE_WRITE | PTE_PRESENT;
+        } else {
+            kernel_page_directory[i] = 0;
+        }
+    }
+    
+    if (!space_cache) {
+        space_cache = kmem_cache_create("address_space_t", sizeof(address_space_t), 0, NULL);
+    }
+    
+    // Enable 4MB pages, load the directory, then turn on paging. CR0.WP
+    // makes kernel-mode writes fault on read-only (copy-on-write) pages.
+    write_cr4(read_cr4() | CR4_PSE);
+    write_cr3((uint32_t)kernel_page_directory);
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+}
+
+// Physical address of the kernel page directory
+uint32_t paging_kernel_cr3(void) {
+    return (uint32_t)kernel_page_directory;
+}
+
+// Identity-map the 4MB region holding phys, uncached, in the kernel
+// directory; address spaces share every PDE above the user region
+void paging_map_mmio(uint32_t phys) {
+    uint32_t pde = phys / PAGING_LARGE_PAGE_SIZE;
+    if (pde < PAGING_USER_PDE_END) {
+        return;  // Identity-mapped RAM or the user region
+    }
+    
+    kernel_page_directory[pde] = (pde * PAGING_LARGE_PAGE_SIZE) | PTE_LARGE | PTE_CACHE_DISABLE |
+                                 PTE_WRITE_THROUGH | PTE_WRITE | PTE_PRESENT;
+    invlpg(pde * PAGING_LARGE_PAGE_SIZE);
+}
+
+// Create an address space with an untouched demand-zero region
+address_space_t *paging_create_space(uint32_t region_size) {
+    if (region_size == 0 || region_size > USER_SPACE_SIZE) {
+        return NULL;  // Invalid region size
+    }
+    
+    address_space_t *space = (address_space_t *)kmem_cache_alloc(space_cache);
+    if (!space) {
+        return NULL;  // Out of memory
+    }
+    
+    uint32_t *directory = (uint32_t *)alloc_pages(0);
+    if (!directory) {
+        kmem_cache_free(space_cache, space);
+        return NULL;  // Out of memory
+    }
+    
+    // Share the kernel mappings, leave the user region unmapped
+    for (uint32_t i = 0; i < PAGING_ENTRIES; i++) {
+        int user = (i >= PAGING_KERNEL_PDES && i < PAGING_USER_PDE_END);
+        directory[i] = user ? 0 : kernel_page_directory[i];
+    }
+    
+    space->page_directory = directory;
+    space->region_start = USER_SPACE_BASE;
+    space->region_size = (region_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    space->page_faults = 0;
+    space->resident_pages = 0;
+    space->cow_copies = 0;
+    
+    return space;
+}
+
+// Drop one mapping of a user frame, keeping the sharing counters in step
+static void frame_unmap(void *frame) {
+    uint32_t refs = page_refcount(frame);
+    
+    if (refs == 1) {
+        paging_stats.private_pages--;
+    } else if (refs == 2) {
+        // The last other mapping becomes the frame's only owner
+        paging_stats.shared_pages--;
+        paging_stats.shared_mappings -= 2;
+        paging_stats.private_pages++;
+    } else if (refs > 2) {
+        paging_stats.shared_mappings--;
+    }
+    
+    page_put(frame, 0);
+}
+
+// Free the page tables and frames of a space (paging_lock held)
+static void destroy_space(address_space_t *space) {
+    uint32_t *directory = space->page_directory;
+    for (uint32_t i = PAGING_KERNEL_PDES; i < PAGING_USER_PDE_END; i++) {
+        if (!(directory[i] & PTE_PRESENT)) {
+            continue;
+        }
+        
+        uint32_t *table = (uint32_t *)(directory[i] & PTE_FRAME_MASK);
+        for (uint32_t j = 0; j < PAGING_ENTRIES; j++) {
+            if (table[j] & PTE_PRESENT) {
+                frame_unmap((void *)(table[j] & PTE_FRAME_MASK));
+            }
+        }
+        free_pages(table, 0);
+    }
+    
+    free_pages(directory, 0);
+    kmem_cache_free(space_cache, space);
+}
+
+// Clone an address space copy-on-write: the child gets its own page tables,
+// but every resident frame is shared read-only until one side writes to it.
+// Call with interrupts on: the parent's threads may be running on other
+// CPUs, whose stale writable translations are shot down at the end.
+address_space_t *paging_clone_space(address_space_t *parent) {
+    if (!parent) {
+        return NULL;
+    }
+    
+    address_space_t *child = paging_create_space(parent->region_size);
+    if (!child) {
+        return NULL;  // Out of memory
+    }
+    
+    uint32_t *parent_dir = parent->page_directory;
+    uint32_t *child_dir = child->page_directory;
+    
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    for (uint32_t i = PAGING_KERNEL_PDES; i < PAGING_USER_PDE_END; i++) {
+        if (!(parent_dir[i] & PTE_PRESENT)) {
+            continue;
+        }
+        
+        uint32_t *child_table = (uint32_t *)alloc_pages(0);
+        if (!child_table) {
+            destroy_space(child);
+            spin_unlock_irqrestore(&paging_lock, flags);
+            smp_tlb_shootdown();
+            return NULL;  // Out of memory
+        }
+        
+        uint32_t *parent_table = (uint32_t *)(parent_dir[i] & PTE_FRAME_MASK);
+        for (uint32_t j = 0; j < PAGING_ENTRIES; j++) {
+            uint32_t entry = parent_table[j];
+            if (entry & PTE_PRESENT) {
+                // Writable pages become read-only copy-on-write in both spaces
+                if (entry & PTE_WRITE) {
+                    entry = (entry & ~PTE_WRITE) | PTE_COW;
+                    parent_table[j] = entry;
+                }
+                
+                void *frame = (void *)(entry & PTE_FRAME_MASK);
+                uint32_t refs = page_refcount(frame);
+                if (refs == 1) {
+                    paging_stats.private_pages--;
+                    paging_stats.shared_pages++;
+                    paging_stats.shared_mappings += 2;
+                } else {
+                    paging_stats.shared_mappings++;
+                }
+                page_get(frame);
+            }
+            child_table[j] = entry;
+        }
+        
+        child_dir[i] = (uint32_t)child_table | PTE_USER | PTE_WRITE | PTE_PRESENT;
+    }
+    
+    child->resident_pages = parent->resident_pages;
+    paging_stats.forks++;
+    spin_unlock_irqrestore(&paging_lock, flags);
+    
+    // Drop stale writable translations of the parent on every CPU
+    smp_tlb_shootdown();
+    
+    return child;
+}
+
+// Free an address space, its page tables and every frame it touched. No
+// CPU may still have it loaded (its threads are off every CPU).
+void paging_destroy_space(address_space_t *space) {
+    if (!space) {
+        return;
+    }
+    
+    if (this_cpu()->space == space) {
+        paging_switch(NULL);
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    destroy_space(space);
+    spin_unlock_irqrestore(&paging_lock, flags);
+}
+
+// Load an address space on this CPU (NULL switches back to the kernel
+// directory)
+void paging_switch(address_space_t *space) {
+    cpu_t *cpu = this_cpu();
+    if (space == cpu->space) {
+        return;
+    }
+    
+    cpu->space = space;
+    write_cr3((uint32_t)(space ? space->page_directory : kernel_page_directory));
+}
+
+// Address space currently loaded on this CPU
+address_space_t *paging_current_space(void) {
+    return this_cpu()->space;
+}
+
+// Back a faulting page of the demand-zero region with a zeroed frame
+static int handle_demand_zero(address_space_t *space, uint32_t addr) {
+    uint32_t *directory = space->page_directory;
+    uint32_t pde = addr >> 22;
+    uint32_t pte = (addr >> 12) & (PAGING_ENTRIES - 1);
+    
+    // Page tables themselves are created on demand
+    if (!(directory[pde] & PTE_PRESENT)) {
+        uint32_t *table = (uint32_t *)kzalloc_page();
+        if (!table) {
+            return 0;
+        }
+        directory[pde] = (uint32_t)table | PTE_USER | PTE_WRITE | PTE_PRESENT;
+    }
+    
+    // Another CPU faulted on the same page first and mapped it
+    uint32_t *table = (uint32_t *)(directory[pde] & PTE_FRAME_MASK);
+    if (table[pte] & PTE_PRESENT) {
+        invlpg(addr & PTE_FRAME_MASK);
+        return 1;
+    }
+    
+    void *frame = kzalloc_page();
+    if (!frame) {
+        return 0;
+    }
+    
+    table[pte] = (uint32_t)frame | PTE_USER | PTE_WRITE | PTE_PRESENT;
+    invlpg(addr & PTE_FRAME_MASK);
+    
+    space->resident_pages++;
+    paging_stats.private_pages++;
+    return 1;
+}
+
+// Resolve a write to a copy-on-write page: copy the frame if it is still
+// shared, otherwise just make the mapping writable again. A replaced
+// frame is handed back in *stale with its reference still held: other
+// CPUs may translate through it until their TLBs are shot down.
+static int handle_cow(address_space_t *space, uint32_t addr, void **stale) {
+    uint32_t *directory = space->page_directory;
+    uint32_t pde = addr >> 22;
+    uint32_t pte = (addr >> 12) & (PAGING_ENTRIES - 1);
+    
+    if (!(directory[pde] & PTE_PRESENT)) {
+        return 0;
+    }
+    
+    uint32_t *table = (uint32_t *)(directory[pde] & PTE_FRAME_MASK);
+    uint32_t entry = table[pte];
+    if ((entry & PTE_PRESENT) && (entry & PTE_WRITE)) {
+        // Resolved by another CPU; this one had the read-only translation
+        invlpg(addr & PTE_FRAME_MASK);
+        return 1;
+    }
+    if (!(entry & PTE_PRESENT) || !(entry & PTE_COW)) {
+        return 0;  // Genuine protection fault
+    }
+    
+    void *frame = (void *)(entry & PTE_FRAME_MASK);
+    uint32_t flags = (entry & ~(PTE_FRAME_MASK | PTE_COW)) | PTE_WRITE;
+    
+    if (page_refcount(frame) == 1) {
+        // Every other mapping is gone: the frame is ours alone
+        table[pte] = (uint32_t)frame | flags;
+        paging_stats.cow_reuses++;
+    } else {
+        void *copy = alloc_pages(0);
+        if (!copy) {
+            return 0;
+        }
+        memcpy(copy, frame, PAGE_SIZE);
+        
+        table[pte] = (uint32_t)copy | flags;
+        *stale = frame;
+        paging_stats.private_pages++;
+        paging_stats.cow_copies++;
+        space->cow_copies++;
+    }
+    
+    invlpg(addr & PTE_FRAME_MASK);
+    return 1;
+}
+
+// Page fault entry point (called from isr.asm)
+void page_fault_handler(uint32_t error_code, uint32_t eip) {
+    uint32_t addr = read_cr2();
+    
+    address_space_t *space = this_cpu()->space;
+    if (space && addr >= space->region_start && addr - space->region_start < space->region_size) {
+        int handled = 0;
+        void *stale = NULL;
+        
+        uint32_t flags = spin_lock_irqsave(&paging_lock);
+        space->page_faults++;
+        if (!(error_code & PF_ERROR_PRESENT)) {
+            handled = handle_demand_zero(space, addr);
+        } else if (error_code & PF_ERROR_WRITE) {
+            handled = handle_cow(space, addr, &stale);
+        }
+        spin_unlock_irqrestore(&paging_lock, flags);
+        
+        // Until every CPU has dropped its translation to the old frame, the
+        // other sharer must not reuse it: only then does it lose this
+        // mapping. The fault came in with interrupts off, and the shootdown
+        // needs them on.
+        if (stale) {
+            asm volatile("sti");
+            smp_tlb_shootdown();
+            asm volatile("cli");
+            
+            flags = spin_lock_irqsave(&paging_lock);
+            frame_unmap(stale);
+            spin_unlock_irqrestore(&paging_lock, flags);
+        }
+        
+        if (handled) {
+            return;
+        }
+    }
+    
+    // Anything else is a kernel bug
+    char buffer[16];
+    console_puts("\n*** PAGE FAULT at ");
+    itoa_hex(addr, buffer);
+    console_puts(buffer);
+    console_puts(" eip ");
+    itoa_hex(eip, buffer);
+    console_puts(buffer);
+    console_puts(" error ");
+    itoa(error_code, buffer);
+    console_puts(buffer);
+    console_puts(" ***\n");
+    
+    asm volatile("cli");
+    while (1) {
+        asm volatile("hlt");
+    }
+}
+
+// Get frame sharing statistics
+void paging_get_stats(paging_stats_t *stats) {
+    if (stats) {
+        *stats = paging_stats;
+    }
+}
+
+// Print shared versus private process pages
+void paging_print_stats(void) {
+    char buffer[16];
+    
+    console_puts("\nProcess Pages:\n");
+    
+    console_puts("Private Pages:    ");
+    itoa(paging_stats.private_pages, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Shared (COW):     ");
+    itoa(paging_stats.shared_pages, buffer);
+    console_puts(buffer);
+    console_puts(" (");
+    itoa(paging_stats.shared_mappings, buffer);
+    console_puts(buffer);
+    console_puts(" mappings)\n");
+    
+    console_puts("Forks:            ");
+    itoa(paging_stats.forks, buffer);
+    console_puts(buffer);
+    console_puts(" | COW Copies: ");
+    itoa(paging_stats.cow_copies, buffer);
+    console_puts(buffer);
+    console_puts(" | Reused: ");
+    itoa(paging_stats.cow_reuses, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+}
@@ -0,0 +1,74 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "page.h"
+
+// Page directory / page table entry flags
+#define PTE_PRESENT 0x001
+#define PTE_WRITE 0x002
+#define PTE_USER 0x004
+#define PTE_WRITE_THROUGH 0x008
+#define PTE_CACHE_DISABLE 0x010
+#define PTE_LARGE 0x080            // 4MB page (PDE only, needs CR4.PSE)
+#define PTE_COW 0x200              // Available bit: read-only copy-on-write mapping
+#define PTE_FRAME_MASK 0xFFFFF000
+
+// Page fault error code bits
+#define PF_ERROR_PRESENT 0x1       // Fault on a present page (protection)
+#define PF_ERROR_WRITE 0x2         // Faulting access was a write
+
+// Address space layout
+#define PAGING_ENTRIES 1024
+#define PAGING_LARGE_PAGE_SIZE 0x400000
+#define PAGING_KERNEL_PDES (PAGE_PHYS_LIMIT / PAGING_LARGE_PAGE_SIZE)  // Identity-mapped 0..3GB
+#define USER_SPACE_BASE PAGE_PHYS_LIMIT    // Process memory starts right above the identity map
+#define USER_SPACE_SIZE 0x30000000         // 768MB per process
+#define PAGING_USER_PDE_END ((USER_SPACE_BASE + USER_SPACE_SIZE) / PAGING_LARGE_PAGE_SIZE)  // Kernel MMIO above
+
+// Per-process address space
+typedef struct {
+    uint32_t *page_directory;      // Page directory (identity-mapped frame)
+    uint32_t region_start;         // Start of the demand-zero region
+    uint32_t region_size;          // Size of the demand-zero region
+    uint32_t page_faults;          // Page faults handled for this space
+    uint32_t resident_pages;       // Pages actually backed by frames
+    uint32_t cow_copies;           // Shared pages copied on a write fault
+} address_space_t;
+
+// Frame sharing statistics across all address spaces
+typedef struct {
+    uint32_t private_pages;        // User frames mapped by exactly one space
+    uint32_t shared_pages;         // User frames mapped copy-on-write by several spaces
+    uint32_t shared_mappings;      // Mappings of shared frames (>= 2 per shared frame)
+    uint32_t forks;                // Address spaces cloned
+    uint32_t cow_copies;           // Write faults that copied a shared frame
+    uint32_t cow_reuses;           // Write faults on a frame that was no longer shared
+} paging_stats_t;
+
+// Initialize paging with the kernel identity map and enable it
+void paging_init(void);
+
+// Physical address of the kernel page directory (for CPUs coming up)
+uint32_t paging_kernel_cr3(void);
+
+// Identity-map the uncached 4MB region holding a device register block
+// above the user region; must run before any address space is created
+void paging_map_mmio(uint32_t phys);
+
+// Address space management
+address_space_t *paging_create_space(uint32_t region_size);
+address_space_t *paging_clone_space(address_space_t *parent);
+void paging_destroy_space(address_space_t *space);
+void paging_switch(address_space_t *space);
+address_space_t *paging_current_space(void);    // Loaded on this CPU
+
+// Page fault entry point (called from isr.asm)
+void page_fault_handler(uint32_t error_code, uint32_t eip);
+
+// Statistics
+void paging_get_stats(paging_stats_t *stats);
+void paging_print_stats(void);
+
+#endif // PAGING_H
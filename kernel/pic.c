@@ -20,3 +20,8 @@ void pic_remap(void) {
     outb(0x21, 0xFC); // Enable IRQ0 (timer) and IRQ1 (keyboard)
     outb(0xA1, 0xFF);
 }
+
+void pic_disable(void) {
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
+}
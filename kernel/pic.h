@@ -1,2 +1,5 @@
 #pragma once
 void pic_remap(void);
+
+// Mask every 8259 input (interrupts come through the I/O APIC)
+void pic_disable(void);
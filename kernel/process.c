@@ -1,60 +1,543 @@
 #include "process.h"
 #include "memory.h"
+#include "slab.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "waitqueue.h"
+#include "cpu.h"
+#include "smp.h"
 
-// Global process manager
+// Global process manager. The process and thread tables are only
+// changed from the shell; the scheduler just looks up slots, which are
+// never moved.
 static process_manager_t pm = {0};
 
+// The boot context (the shell) runs as this thread: no process, boot
+// stack. It stays on CPU 0 with the keyboard and console it drives.
+static thread_t kernel_thread;
+
+// One idle thread per CPU, never on a run queue. CPU 0's starts from a
+// built frame; the others are entered by process_cpu_start().
+static thread_t idle_threads[MAX_CPUS];
+static uint8_t idle_stacks[MAX_CPUS][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+// Object caches for process_t and thread_t
+static kmem_cache_t *process_cache = NULL;
+static kmem_cache_t *thread_cache = NULL;
+
+// TSC at the last process_sample_cpu()
+static uint64_t cpu_sampled_at = 0;
+
 // External function declarations
 void console_puts(const char *s);
 void console_putchar(char c);
 void itoa(int num, char *str);
+int strcmp(const char *a, const char *b);
+
+// Append a thread to the FIFO of its priority
+static void run_queue_push(run_queue_t *rq, thread_t *thread) {
+    uint32_t prio = thread->priority;
+    
+    thread->next = NULL;
+    thread->prev = rq->tail[prio];
+    if (rq->tail[prio]) {
+        rq->tail[prio]->next = thread;
+    } else {
+        rq->head[prio] = thread;
+        rq->bitmap |= 1u << prio;
+    }
+    rq->tail[prio] = thread;
+    rq->count++;
+}
+
+// Unlink a thread from its FIFO; threads not on the queue are ignored
+static void run_queue_remove(run_queue_t *rq, thread_t *thread) {
+    uint32_t prio = thread->priority;
+    
+    if (thread->prev) {
+        thread->prev->next = thread->next;
+    } else if (rq->head[prio] == thread) {
+        rq->head[prio] = thread->next;
+    } else {
+        return;  // Not queued
+    }
+    
+    if (thread->next) {
+        thread->next->prev = thread->prev;
+    } else {
+        rq->tail[prio] = thread->prev;
+    }
+    
+    if (!rq->head[prio]) {
+        rq->bitmap &= ~(1u << prio);
+    }
+    thread->next = NULL;
+    thread->prev = NULL;
+    rq->count--;
+}
+
+// Dequeue the oldest thread of the highest non-empty priority
+static thread_t *run_queue_pop(run_queue_t *rq) {
+    if (!rq->bitmap) {
+        return NULL;
+    }
+    
+    thread_t *thread = rq->head[bsr(rq->bitmap)];
+    run_queue_remove(rq, thread);
+    return thread;
+}
+
+// Take the highest-priority thread that may migrate (for stealing)
+static thread_t *run_queue_steal(run_queue_t *rq) {
+    uint32_t bitmap = rq->bitmap;
+    
+    while (bitmap) {
+        uint32_t prio = bsr(bitmap);
+        for (thread_t *thread = rq->head[prio]; thread; thread = thread->next) {
+            if (!thread->pinned) {
+                run_queue_remove(rq, thread);
+                return thread;
+            }
+        }
+        bitmap &= ~(1u << prio);
+    }
+    return NULL;
+}
+
+// Priority class hooks on top of the run queue FIFOs
+static void prio_enqueue(run_queue_t *rq, thread_t *thread, uint32_t flags) {
+    (void)flags;
+    run_queue_push(rq, thread);
+}
+
+static thread_t *prio_steal(run_queue_t *from, run_queue_t *to) {
+    (void)to;
+    return run_queue_steal(from);
+}
+
+static void prio_charge(run_queue_t *rq, thread_t *thread, uint64_t ns) {
+    (void)rq;
+    (void)thread;
+    (void)ns;
+}
+
+// The running thread keeps the CPU only if nothing at its level or
+// above waits, which makes the levels round robin
+static int prio_tick_preempt(run_queue_t *rq, thread_t *current) {
+    return rq->bitmap && bsr(rq->bitmap) >= current->priority;
+}
+
+static int prio_wakeup_preempt(thread_t *current, thread_t *thread) {
+    return current->priority < thread->priority;
+}
+
+const sched_class_t prio_sched_class = {
+    .name = "prio",
+    .enqueue = prio_enqueue,
+    .dequeue = run_queue_remove,
+    .pick_next = run_queue_pop,
+    .steal = prio_steal,
+    .charge = prio_charge,
+    .tick_preempt = prio_tick_preempt,
+    .wakeup_preempt = prio_wakeup_preempt,
+};
+
+// Class every CPU schedules normal threads with, fixed at boot
+static const sched_class_t *sched_class = &prio_sched_class;
+
+// Class a thread is queued and charged through
+static const sched_class_t *thread_class(const thread_t *thread) {
+    return thread->edf.params.runtime_ms ? &edf_sched_class : sched_class;
+}
+
+// Lock the run queue of the CPU a thread belongs to (interrupts off).
+// thread->cpu only changes under that lock, so check it again once held.
+static cpu_t *thread_lock_cpu(thread_t *thread) {
+    while (1) {
+        cpu_t *cpu = smp_get_cpu(thread->cpu);
+        spin_lock(&cpu->run_queue.lock);
+        if (thread->cpu == cpu->id) {
+            return cpu;
+        }
+        spin_unlock(&cpu->run_queue.lock);
+    }
+}
+
+// Interrupt a CPU whose running thread a newly queued one should preempt
+// (run queue lock held). Real-time threads always preempt normal ones.
+static void check_preempt(cpu_t *cpu, thread_t *thread) {
+    thread_t *current = cpu->current;
+    const sched_class_t *class = thread_class(thread);
+    int preempt;
+    
+    if (!current || current == cpu->idle) {
+        preempt = 1;
+    } else if (class != thread_class(current)) {
+        preempt = (class == &edf_sched_class);
+    } else {
+        preempt = class->wakeup_preempt(current, thread);
+    }
+    
+    if (preempt) {
+        smp_send_reschedule(cpu->id);
+    }
+}
+
+// Online CPU with the fewest runnable threads
+static cpu_t *least_loaded_cpu(void) {
+    cpu_t *best = smp_get_cpu(0);
+    uint32_t best_load = 0xFFFFFFFF;
+    
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        cpu_t *cpu = smp_get_cpu(i);
+        if (!cpu->online) {
+            continue;
+        }
+        
+        uint32_t load = cpu->run_queue.count + (cpu->current != cpu->idle);
+        if (load < best_load) {
+            best = cpu;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+// Make a new thread runnable on the least loaded CPU, or on its own if
+// it is pinned
+static void ready_queue_insert(thread_t *thread) {
+    uint32_t flags = irq_save();
+    cpu_t *cpu = thread->pinned ? smp_get_cpu(thread->cpu) : least_loaded_cpu();
+    spin_lock(&cpu->run_queue.lock);
+    thread->cpu = cpu->id;
+    thread->ready_since = clock_cycles();
+    thread_class(thread)->enqueue(&cpu->run_queue, thread, SCHED_ENQUEUE_NEW);
+    check_preempt(cpu, thread);
+    spin_unlock(&cpu->run_queue.lock);
+    irq_restore(flags);
+}
+
+// Mark a thread terminated and take it off its run queue if it is on
+// it; a real-time thread's bandwidth is free for others from here on
+static void thread_stop(thread_t *thread) {
+    uint32_t flags = irq_save();
+    cpu_t *cpu = thread_lock_cpu(thread);
+    thread->state = THREAD_TERMINATED;
+    thread_class(thread)->dequeue(&cpu->run_queue, thread);
+    spin_unlock(&cpu->run_queue.lock);
+    irq_restore(flags);
+    edf_release(thread);
+}
+
+// Start a thread's CPU accounting from zero, as of now
+static void thread_init_accounting(thread_t *thread) {
+    uint64_t now = clock_cycles();
+    thread->run_cycles = 0;
+    thread->wait_cycles = 0;
+    thread->switched_in = now;
+    thread->ready_since = now;
+    thread->sampled_cycles = 0;
+    thread->cpu_percent = 0;
+    thread->voluntary_switches = 0;
+    thread->involuntary_switches = 0;
+    thread->vruntime = 0;
+    rb_clear_node(&thread->run_node);
+}
+
+// Log2 histogram bucket (process.h) of a run-queue wait
+static uint32_t sched_lat_bucket(uint64_t cycles) {
+    uint64_t us = udiv64_32(clock_cycles_to_ns(cycles), 1000, NULL);
+    if (us == 0) {
+        return 0;
+    }
+    if (us >= (1u << (SCHED_LAT_BUCKETS - 2))) {
+        return SCHED_LAT_BUCKETS - 1;
+    }
+    return bsr((uint32_t)us) + 1;
+}
+
+// Entry points that return end up here: the running thread is not on
+// a run queue, so marking it terminated means the timer switches away
+// for good. thread_terminate() reclaims the stack later.
+static void thread_exit(void) {
+    irq_save();
+    process_current_thread()->state = THREAD_TERMINATED;
+    
+    while (1) {
+        asm volatile("sti; hlt");
+    }
+}
+
+// Build the frame isr_timer pops on the first switch to a thread: it
+// "returns" into entry with interrupts on, and entry itself returns
+// into thread_exit()
+static void thread_build_frame(thread_t *thread, void (*entry)(void)) {
+    uint32_t *top = (uint32_t *)(thread->stack + thread->stack_size);
+    *--top = (uint32_t)thread_exit;
+    thread_frame_t *frame = (thread_frame_t *)top - 1;
+    frame->gs = KERNEL_DATA_SELECTOR;
+    frame->fs = KERNEL_DATA_SELECTOR;
+    frame->es = KERNEL_DATA_SELECTOR;
+    frame->ds = KERNEL_DATA_SELECTOR;
+    frame->edi = 0;
+    frame->esi = 0;
+    frame->ebp = 0;
+    frame->esp_dummy = 0;
+    frame->ebx = 0;
+    frame->edx = 0;
+    frame->ecx = 0;
+    frame->eax = 0;
+    frame->eip = (uint32_t)entry;
+    frame->cs = KERNEL_CODE_SELECTOR;
+    frame->eflags = EFLAGS_RESERVED | EFLAGS_IF;
+    thread->esp = (uint32_t)frame;
+    thread->ebp = 0;
+}
+
+// Idle thread body: background memory work while there is some (CPU 0
+// only), then halt until the next interrupt. sti takes effect after the
+// following instruction, so a wakeup between the check and hlt is not
+// lost. Work queued on other CPUs is stolen at the next timer tick.
+static void idle_main(void) {
+    cpu_t *cpu = this_cpu();
+    
+    while (1) {
+        if (cpu->run_queue.count > 0) {
+            thread_yield();
+            continue;
+        }
+        
+        if (cpu->id == 0 && (memory_zero_refill(MEMORY_ZERO_STEP) || memory_compact(MEMORY_COMPACT_STEP))) {
+            continue;
+        }
+        
+        asm volatile("cli");
+        if (cpu->run_queue.count == 0) {
+            asm volatile("sti; hlt");
+        } else {
+            asm volatile("sti");
+        }
+    }
+}
 
 // Initialize process manager
 void process_manager_init(void) {
-    pm.process_count = 0;
-    pm.current_pid = 0;
-    pm.current_tid = 0;
-    pm.next_pid = 1;
-    pm.next_tid = 1;
-    pm.ready_queue = NULL;
-    pm.current_thread = NULL;
+    handle_table_init(&pm.processes, MAX_PROCESSES);
+    handle_table_init(&pm.threads, MAX_THREADS);
+    pm.terminated = 0;
+    
+    // The code that called us keeps running as the kernel thread once
+    // the timer starts switching
+    kernel_thread.tid = 0;
+    kernel_thread.pid = 0;
+    kernel_thread.state = THREAD_RUNNING;
+    kernel_thread.stack = NULL;
+    kernel_thread.stack_size = 0;
+    kernel_thread.ticks = 0;
+    kernel_thread.priority = 5;
+    kernel_thread.entry_point = NULL;
+    kernel_thread.next = NULL;
+    kernel_thread.prev = NULL;
+    kernel_thread.timer.pending = 0;
+    kernel_thread.wait_queue = NULL;
+    kernel_thread.wait_next = NULL;
+    kernel_thread.wait_prev = NULL;
+    kernel_thread.cpu = 0;
+    kernel_thread.on_cpu = 1;
+    kernel_thread.pinned = 1;
+    thread_init_accounting(&kernel_thread);
+    
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        cpu_t *cpu = smp_get_cpu(c);
+        run_queue_t *rq = &cpu->run_queue;
+        for (uint32_t i = 0; i < THREAD_PRIORITY_LEVELS; i++) {
+            rq->head[i] = NULL;
+            rq->tail[i] = NULL;
+        }
+        rq->bitmap = 0;
+        rb_init(&rq->timeline);
+        rq->min_vruntime = 0;
+        rb_init(&rq->deadlines);
+        rq->count = 0;
+        spin_init(&rq->lock);
+        
+        thread_t *idle = &idle_threads[c];
+        idle->tid = handle_alloc(&pm.threads, idle);
+        idle->pid = 0;
+        idle->state = THREAD_READY;
+        idle->stack = idle_stacks[c];
+        idle->stack_size = THREAD_STACK_SIZE;
+        idle->ticks = 0;
+        idle->priority = 0;
+        idle->entry_point = idle_main;
+        idle->next = NULL;
+        idle->prev = NULL;
+        idle->timer.pending = 0;
+        idle->wait_queue = NULL;
+        idle->wait_next = NULL;
+        idle->wait_prev = NULL;
+        idle->cpu = c;
+        idle->on_cpu = 0;
+        idle->pinned = 1;
+        thread_init_accounting(idle);
+        
+        cpu->idle = idle;
+        cpu->current = NULL;
+        cpu->prev = NULL;
+        cpu->ticks = 0;
+        cpu->steals = 0;
+    }
+    thread_build_frame(&idle_threads[0], idle_main);
+    smp_get_cpu(0)->current = &kernel_thread;
+    cpu_sampled_at = clock_cycles();
+    
+    if (!process_cache) {
+        process_cache = kmem_cache_create("process_t", sizeof(process_t), 0, NULL);
+    }
+    if (!thread_cache) {
+        thread_cache = kmem_cache_create("thread_t", sizeof(thread_t), 0, NULL);
+    }
 }
 
-// Create a new process
-uint32_t process_create(void (*entry)(void), uint32_t memory_size, const char *name) {
-    if (pm.process_count >= MAX_PROCESSES) {
-        return 0;  // Too many processes
+// Choose the scheduling class; the run queues must still be empty
+int process_set_sched_class(const char *name) {
+    if (strcmp(name, prio_sched_class.name) == 0) {
+        sched_class = &prio_sched_class;
+    } else if (strcmp(name, fair_sched_class.name) == 0) {
+        sched_class = &fair_sched_class;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Name of the scheduling class in use
+const char *process_sched_class_name(void) {
+    return sched_class->name;
+}
+
+static uint32_t thread_spawn(uint32_t pid, void (*entry)(void), uint32_t priority, const edf_params_t *params, int cpu);
+
+// Allocate a process with no threads yet and give it a PID (a free
+// process table slot, reused before the table grows); NULL if the table
+// is full or memory runs out
+static process_t *process_alloc(address_space_t *space, uint32_t memory_size) {
+    process_t *proc = (process_t *)kmem_cache_alloc(process_cache);
+    if (!proc) {
+        return NULL;
     }
     
+    proc->pid = 0;
+    proc->parent_pid = 0;
+    proc->state = PROC_CREATED;
+    proc->memory_start = (void *)space->region_start;
+    proc->memory_size = memory_size;
+    proc->address_space = space;
+    proc->main_thread = NULL;
+    proc->threads = NULL;
+    proc->thread_count = 0;
+    proc->thread_capacity = 0;
+    proc->created_ns = clock_monotonic_ns();
+    proc->total_ticks = 0;
+    
+    // The PID must resolve for thread_spawn()
+    proc->pid = handle_alloc(&pm.processes, proc);
+    if (!proc->pid) {
+        kmem_cache_free(process_cache, proc);
+        return NULL;
+    }
+    return proc;
+}
+
+// Retire a process's PID and free it (its threads are gone already)
+static void process_free(process_t *proc) {
+    handle_free(&pm.processes, proc->pid);
+    if (proc->threads) {
+        free(proc->threads);
+    }
+    kmem_cache_free(process_cache, proc);
+}
+
+// Create a new process whose main thread is normal (params NULL) or
+// real-time
+static uint32_t process_spawn(void (*entry)(void), uint32_t memory_size, const char *name, const edf_params_t *params) {
     if (!entry) {
         return 0;  // Invalid entry point
     }
     
-    // Allocate process memory
-    void *proc_memory = malloc(memory_size);
-    if (!proc_memory) {
+    // Reserve process memory; frames are only allocated when touched
+    address_space_t *space = paging_create_space(memory_size);
+    if (!space) {
         return 0;  // Out of memory
     }
     
     // Create process structure
-    process_t *proc = &pm.processes[pm.process_count];
-    proc->pid = pm.next_pid++;
-    proc->state = PROC_CREATED;
-    proc->memory_start = proc_memory;
-    proc->memory_size = memory_size;
-    proc->thread_count = 0;
-    proc->created_ticks = 0;  // TODO: use actual tick count
+    process_t *proc = process_alloc(space, memory_size);
+    if (!proc) {
+        paging_destroy_space(space);
+        return 0;  // Too many processes, or out of memory
+    }
     
     // Create main thread
-    uint32_t tid = thread_create(proc->pid, entry, 5);
+    uint32_t tid = thread_spawn(proc->pid, entry, 5, params, -1);
+    if (tid == 0) {
+        process_free(proc);
+        paging_destroy_space(space);
+        return 0;
+    }
+    
+    proc->main_thread = thread_get_by_id(tid);
+    proc->state = PROC_READY;
+    
+    return proc->pid;
+}
+
+// Create a new process
+uint32_t process_create(void (*entry)(void), uint32_t memory_size, const char *name) {
+    return process_spawn(entry, memory_size, name, NULL);
+}
+
+// Create a new process with a real-time main thread
+uint32_t process_create_deadline(void (*entry)(void), uint32_t memory_size, const char *name, const edf_params_t *params) {
+    if (!params) {
+        return 0;
+    }
+    return process_spawn(entry, memory_size, name, params);
+}
+
+// Fork a process: the child shares the parent's pages copy-on-write and
+// starts a main thread at the parent's entry point and priority
+uint32_t process_fork(uint32_t pid) {
+    process_t *parent = process_get_by_id(pid);
+    if (!parent || parent->state == PROC_TERMINATED || !parent->address_space || !parent->main_thread) {
+        return 0;  // Nothing to fork
+    }
+    
+    // Page tables are copied, frames are shared until written; the
+    // parent's threads may keep running elsewhere, the clone shoots down
+    // their stale translations
+    address_space_t *space = paging_clone_space(parent->address_space);
+    if (!space) {
+        return 0;  // Out of memory
+    }
+    
+    process_t *proc = process_alloc(space, parent->memory_size);
+    if (!proc) {
+        paging_destroy_space(space);
+        return 0;  // Too many processes, or out of memory
+    }
+    proc->parent_pid = parent->pid;
+    proc->memory_start = parent->memory_start;
+    
+    uint32_t tid = thread_create(proc->pid, parent->main_thread->entry_point, parent->main_thread->priority);
     if (tid == 0) {
-        free(proc_memory);
+        process_free(proc);
+        paging_destroy_space(space);
         return 0;
     }
     
     proc->main_thread = thread_get_by_id(tid);
     proc->state = PROC_READY;
-    pm.process_count++;
     
     return proc->pid;
 }
@@ -66,30 +549,49 @@ int process_terminate(uint32_t pid) {
         return 0;
     }
     
-    // Terminate all threads
+    // Terminate all threads and stop scheduling them
     for (uint32_t i = 0; i < proc->thread_count; i++) {
         if (proc->threads[i]) {
-            proc->threads[i]->state = THREAD_TERMINATED;
+            thread_stop(proc->threads[i]);
+            timer_cancel(&proc->threads[i]->timer);
+            timer_cancel(&proc->threads[i]->edf.replenish);
+            wait_queue_remove(proc->threads[i]);
+        }
+    }
+    
+    // Threads running on other CPUs stop at those CPUs' next tick; the
+    // address space stays until none of them is on its stack any more
+    for (uint32_t i = 0; i < proc->thread_count; i++) {
+        while (proc->threads[i] && proc->threads[i]->on_cpu) {
+            cpu_relax();
         }
     }
     
-    // Free process memory
-    if (proc->memory_start) {
-        free(proc->memory_start);
+    // Free the threads, then process memory
+    for (uint32_t i = 0; i < proc->thread_count; i++) {
+        thread_t *thread = proc->threads[i];
+        if (thread) {
+            handle_free(&pm.threads, thread->tid);
+            if (thread->stack) {
+                free(thread->stack);
+            }
+            kmem_cache_free(thread_cache, thread);
+        }
+    }
+    proc->thread_count = 0;
+    if (proc->address_space) {
+        paging_destroy_space(proc->address_space);
+        proc->address_space = NULL;
     }
     
-    proc->state = PROC_TERMINATED;
+    process_free(proc);
+    pm.terminated++;
     return 1;
 }
 
 // Get process by ID
 process_t* process_get_by_id(uint32_t pid) {
-    for (uint32_t i = 0; i < pm.process_count; i++) {
-        if (pm.processes[i].pid == pid) {
-            return &pm.processes[i];
-        }
-    }
-    return NULL;
+    return (process_t *)handle_lookup(&pm.processes, pid);
 }
 
 // Get process state
@@ -101,19 +603,45 @@ process_state_t process_get_state(uint32_t pid) {
     return PROC_TERMINATED;
 }
 
-// Create a new thread
-uint32_t thread_create(uint32_t pid, void (*entry)(void), uint32_t priority) {
+// Double a process's thread list, up to MAX_THREADS_PER_PROCESS; 0 if
+// out of memory
+static int process_grow_threads(process_t *proc) {
+    uint32_t capacity = proc->thread_capacity ? proc->thread_capacity * 2 : PROCESS_THREADS_INITIAL;
+    if (capacity > MAX_THREADS_PER_PROCESS) {
+        capacity = MAX_THREADS_PER_PROCESS;
+    }
+    
+    thread_t **threads = (thread_t **)realloc(proc->threads, capacity * sizeof(thread_t *));
+    if (!threads) {
+        return 0;
+    }
+    proc->threads = threads;
+    proc->thread_capacity = capacity;
+    return 1;
+}
+
+// Create a new thread, real-time if params is set: it only starts if
+// admission control finds a CPU with room for it. Otherwise a cpu >= 0
+// pins it to that CPU.
+static uint32_t thread_spawn(uint32_t pid, void (*entry)(void), uint32_t priority, const edf_params_t *params, int cpu) {
     process_t *proc = process_get_by_id(pid);
     if (!proc) {
         return 0;  // Process not found
     }
     
+    if (cpu >= MAX_CPUS || (cpu >= 0 && !smp_get_cpu(cpu)->online)) {
+        return 0;  // No such CPU
+    }
+    
     if (proc->thread_count >= MAX_THREADS_PER_PROCESS) {
         return 0;  // Too many threads
     }
+    if (proc->thread_count == proc->thread_capacity && !process_grow_threads(proc)) {
+        return 0;  // Out of memory
+    }
     
     // Allocate thread structure
-    thread_t *thread = (thread_t *)malloc(sizeof(thread_t));
+    thread_t *thread = (thread_t *)kmem_cache_alloc(thread_cache);
     if (!thread) {
         return 0;  // Out of memory
     }
@@ -121,23 +649,61 @@ uint32_t thread_create(uint32_t pid, void (*entry)(void), uint32_t priority) {
     // Allocate thread stack
     uint8_t *stack = (uint8_t *)malloc(THREAD_STACK_SIZE);
     if (!stack) {
-        free(thread);
+        kmem_cache_free(thread_cache, thread);
         return 0;  // Out of memory
     }
     
+    // Nothing looks the TID up before this returns it
+    thread->tid = handle_alloc(&pm.threads, thread);
+    if (!thread->tid) {
+        free(stack);
+        kmem_cache_free(thread_cache, thread);
+        return 0;  // Too many threads
+    }
+    
+    int rt_cpu = -1;
+    if (params) {
+        rt_cpu = edf_admit(params);
+        if (rt_cpu < 0) {
+            handle_free(&pm.threads, thread->tid);
+            free(stack);
+            kmem_cache_free(thread_cache, thread);
+            return 0;  // Not schedulable
+        }
+    }
+    
     // Initialize thread
-    thread->tid = pm.next_tid++;
     thread->pid = pid;
     thread->state = THREAD_CREATED;
     thread->stack = stack;
     thread->stack_size = THREAD_STACK_SIZE;
-    thread->esp = (uint32_t)(stack + THREAD_STACK_SIZE - 4);
-    thread->ebp = thread->esp;
     thread->eip = (uint32_t)entry;
     thread->entry_point = entry;
-    thread->priority = priority;
+    thread->priority = (priority > THREAD_PRIORITY_MAX) ? THREAD_PRIORITY_MAX : priority;
     thread->ticks = 0;
     thread->next = NULL;
+    thread->prev = NULL;
+    thread->timer.pending = 0;
+    thread->wait_queue = NULL;
+    thread->wait_next = NULL;
+    thread->wait_prev = NULL;
+    thread->cpu = 0;
+    thread->on_cpu = 0;
+    thread->pinned = 0;
+    thread_init_accounting(thread);
+    if (params) {
+        edf_init_thread(thread, params, rt_cpu);
+    } else {
+        thread->edf.params.runtime_ms = 0;
+        thread->edf.admitted = 0;
+        thread->edf.replenish.pending = 0;
+        if (cpu >= 0) {
+            thread->cpu = cpu;
+            thread->pinned = 1;
+        }
+    }
+    
+    thread_build_frame(thread, entry);
     
     // Add thread to process
     proc->threads[proc->thread_count] = thread;
@@ -145,51 +711,47 @@ uint32_t thread_create(uint32_t pid, void (*entry)(void), uint32_t priority) {
     
     // Add to ready queue
     thread->state = THREAD_READY;
-    if (!pm.ready_queue) {
-        pm.ready_queue = thread;
-        thread->next = NULL;
-    } else {
-        // Insert in priority order (higher priority first)
-        thread_t *current = pm.ready_queue;
-        thread_t *prev = NULL;
-        
-        while (current && current->priority >= thread->priority) {
-            prev = current;
-            current = current->next;
-        }
-        
-        if (!prev) {
-            thread->next = pm.ready_queue;
-            pm.ready_queue = thread;
-        } else {
-            thread->next = current;
-            prev->next = thread;
-        }
-    }
+    ready_queue_insert(thread);
     
     return thread->tid;
 }
 
+// Create a new thread
+uint32_t thread_create(uint32_t pid, void (*entry)(void), uint32_t priority) {
+    return thread_spawn(pid, entry, priority, NULL, -1);
+}
+
+// Create a new thread that only ever runs on the given CPU
+uint32_t thread_create_on(uint32_t pid, void (*entry)(void), uint32_t priority, uint32_t cpu) {
+    if (cpu >= MAX_CPUS) {
+        return 0;
+    }
+    return thread_spawn(pid, entry, priority, NULL, (int)cpu);
+}
+
+// Create a new real-time thread
+uint32_t thread_create_deadline(uint32_t pid, void (*entry)(void), const edf_params_t *params) {
+    if (!params) {
+        return 0;
+    }
+    return thread_spawn(pid, entry, 5, params, -1);
+}
+
 // Terminate a thread
 int thread_terminate(uint32_t tid) {
     thread_t *thread = thread_get_by_id(tid);
-    if (!thread) {
-        return 0;
+    if (!thread || thread == process_current_thread()) {
+        return 0;  // Unknown, or still running on the stack we would free
     }
     
-    thread->state = THREAD_TERMINATED;
+    thread_stop(thread);
+    timer_cancel(&thread->timer);
+    timer_cancel(&thread->edf.replenish);
+    wait_queue_remove(thread);
     
-    // Remove from ready queue if present
-    if (pm.ready_queue == thread) {
-        pm.ready_queue = thread->next;
-    } else {
-        thread_t *current = pm.ready_queue;
-        while (current && current->next != thread) {
-            current = current->next;
-        }
-        if (current) {
-            current->next = thread->next;
-        }
+    // Wait for another CPU to switch away from it
+    while (thread->on_cpu) {
+        cpu_relax();
     }
     
     // Free thread stack
@@ -197,23 +759,36 @@ int thread_terminate(uint32_t tid) {
         free(thread->stack);
     }
     
-    // Free thread structure
-    free(thread);
+    // Drop the process's reference before the object goes back to the
+    // cache; the last thread in the list takes its place
+    process_t *proc = process_get_by_id(thread->pid);
+    if (proc) {
+        for (uint32_t i = 0; i < proc->thread_count; i++) {
+            if (proc->threads[i] == thread) {
+                proc->threads[i] = proc->threads[--proc->thread_count];
+                break;
+            }
+        }
+        if (proc->main_thread == thread) {
+            proc->main_thread = NULL;
+        }
+    }
+    
+    // Free thread structure and retire the TID
+    handle_free(&pm.threads, tid);
+    kmem_cache_free(thread_cache, thread);
     
     return 1;
 }
 
-// Get thread by ID
+// Get thread by ID. Idle threads hold TIDs too, but belong to no
+// process and are not handed out.
 thread_t* thread_get_by_id(uint32_t tid) {
-    for (uint32_t i = 0; i < pm.process_count; i++) {
-        process_t *proc = &pm.processes[i];
-        for (uint32_t j = 0; j < proc->thread_count; j++) {
-            if (proc->threads[j] && proc->threads[j]->tid == tid) {
-                return proc->threads[j];
-            }
-        }
+    thread_t *thread = (thread_t *)handle_lookup(&pm.threads, tid);
+    if (!thread || thread->pid == 0) {
+        return NULL;
     }
-    return NULL;
+    return thread;
 }
 
 // Get thread state
@@ -225,52 +800,338 @@ thread_state_t thread_get_state(uint32_t tid) {
     return THREAD_TERMINATED;
 }
 
-// Set thread priority
+// Set thread priority, moving a ready thread to the tail of its new level
 void thread_set_priority(uint32_t tid, uint32_t priority) {
     thread_t *thread = thread_get_by_id(tid);
-    if (thread) {
+    if (!thread) {
+        return;
+    }
+    
+    if (priority > THREAD_PRIORITY_MAX) {
+        priority = THREAD_PRIORITY_MAX;
+    }
+    
+    // A READY thread not on a CPU is queued and has to move levels
+    // (or, in the fair class, change weight)
+    uint32_t flags = irq_save();
+    cpu_t *cpu = thread_lock_cpu(thread);
+    if (thread->state == THREAD_READY && !thread->on_cpu) {
+        thread_class(thread)->dequeue(&cpu->run_queue, thread);
+        thread->priority = priority;
+        thread_class(thread)->enqueue(&cpu->run_queue, thread, 0);
+    } else {
         thread->priority = priority;
     }
+    spin_unlock(&cpu->run_queue.lock);
+    irq_restore(flags);
 }
 
-// Get next thread from ready queue
-thread_t* process_get_next_thread(void) {
-    if (!pm.ready_queue) {
+// Take a thread from the busiest other CPU (own run queue lock held).
+// trylock avoids lock-order deadlocks between two CPUs stealing from
+// each other; a busy victim is simply skipped until the next tick.
+static thread_t *steal_thread(cpu_t *cpu) {
+    cpu_t *victim = NULL;
+    uint32_t most = 0;
+    
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        cpu_t *other = smp_get_cpu(i);
+        if (other != cpu && other->online && other->run_queue.count > most) {
+            victim = other;
+            most = other->run_queue.count;
+        }
+    }
+    
+    if (!victim || !spin_trylock(&victim->run_queue.lock)) {
         return NULL;
     }
     
-    thread_t *next_thread = pm.ready_queue;
+    thread_t *thread = sched_class->steal(&victim->run_queue, &cpu->run_queue);
+    if (thread) {
+        thread->cpu = cpu->id;
+        cpu->steals++;
+    }
+    spin_unlock(&victim->run_queue.lock);
+    return thread;
+}
+
+// Whether a queued thread should take the CPU from the running one at a
+// tick: real-time threads go by deadline and run ahead of normal ones
+static int tick_preempt(run_queue_t *rq, thread_t *current) {
+    if (thread_class(current) == &edf_sched_class) {
+        return edf_sched_class.tick_preempt(rq, current);
+    }
+    return rb_first(&rq->deadlines) || sched_class->tick_preempt(rq, current);
+}
+
+// Save the current thread's frame, pick the next thread and switch to
+// it and its address space. The previous thread is not requeued here:
+// this CPU is still on its stack until process_finish_switch().
+// voluntary says whether prev asked to give up the CPU; one that
+// blocked or exited did so either way.
+static uint32_t switch_threads(uint32_t esp, int voluntary) {
+    cpu_t *cpu = this_cpu();
+    run_queue_t *rq = &cpu->run_queue;
+    thread_t *prev = cpu->current;
+    prev->esp = esp;
+    
+    // Charge the time since prev started (or was last charged)
+    uint64_t now = clock_cycles();
+    uint64_t ran = now - prev->switched_in;
+    prev->run_cycles += ran;
+    prev->switched_in = now;
     
-    // Move to back of queue for round-robin within same priority
-    if (next_thread && next_thread->next) {
-        pm.ready_queue = next_thread->next;
+    spin_lock(&rq->lock);
+    
+    // Threads that blocked, exited or were terminated stay off the run
+    // queue; a thread woken while still here is READY already
+    int preempted = 0;
+    if (prev->state == THREAD_RUNNING) {
+        prev->state = THREAD_READY;
+        prev->ready_since = now;
+        preempted = !voluntary;
+    }
+    
+    // Charging may throttle a real-time thread out of budget
+    if (prev != cpu->idle) {
+        thread_class(prev)->charge(rq, prev, clock_cycles_to_ns(ran));
+    }
+    int runnable = (prev->state == THREAD_READY && prev != cpu->idle);
+    
+    // The classes decide whether the previous thread keeps the CPU
+    thread_t *next;
+    if (runnable && !tick_preempt(rq, prev)) {
+        next = prev;
+    } else {
+        next = edf_sched_class.pick_next(rq);
+        if (!next) {
+            next = sched_class->pick_next(rq);
+        }
+        if (!next) {
+            next = steal_thread(cpu);
+        }
+        if (!next) {
+            next = cpu->idle;
+        }
+    }
+    
+    if (next != prev) {
+        cpu->prev = prev;
+        next->on_cpu = 1;
+        next->cpu = cpu->id;
         
-        thread_t *current = pm.ready_queue;
-        while (current->next) {
-            current = current->next;
+        if (preempted) {
+            prev->involuntary_switches++;
+        } else {
+            prev->voluntary_switches++;
         }
-        current->next = next_thread;
-        next_thread->next = NULL;
+        
+        // Time on a run queue, stolen threads included (the TSCs of all
+        // CPUs are assumed to be in step)
+        if (next != cpu->idle) {
+            uint64_t waited = (now > next->ready_since) ? now - next->ready_since : 0;
+            next->wait_cycles += waited;
+            cpu->wait_hist[sched_lat_bucket(waited)]++;
+        }
+        next->switched_in = now;
     }
+    next->state = THREAD_RUNNING;
+    cpu->current = next;
+    spin_unlock(&rq->lock);
     
-    return next_thread;
+    if (next != prev && runnable) {
+        process_t *proc = process_get_by_id(prev->pid);
+        if (proc && proc->state == PROC_RUNNING) {
+            proc->state = PROC_READY;
+        }
+    }
+    process_t *next_proc = process_get_by_id(next->pid);
+    if (next_proc) {
+        next_proc->state = PROC_RUNNING;
+    }
+    paging_switch(next_proc ? next_proc->address_space : NULL);
+    
+    return next->esp;
+}
+
+// Requeue the thread switched away from, now that this CPU runs on the
+// next thread's stack
+void process_finish_switch(void) {
+    cpu_t *cpu = this_cpu();
+    thread_t *prev = cpu->prev;
+    if (!prev) {
+        return;
+    }
+    cpu->prev = NULL;
+    
+    spin_lock(&cpu->run_queue.lock);
+    prev->on_cpu = 0;
+    if (prev->state == THREAD_READY && prev != cpu->idle) {
+        thread_class(prev)->enqueue(&cpu->run_queue, prev, 0);
+    }
+    spin_unlock(&cpu->run_queue.lock);
+}
+
+// An application processor becomes its idle thread: ap_main() already
+// runs on the idle stack, so the thread simply starts here
+void process_cpu_start(void) {
+    cpu_t *cpu = this_cpu();
+    thread_t *idle = cpu->idle;
+    
+    idle->state = THREAD_RUNNING;
+    idle->on_cpu = 1;
+    idle->switched_in = clock_cycles();
+    cpu->current = idle;
+    
+    asm volatile("sti");
+    idle_main();
 }
 
-// Schedule next thread to run
-void process_schedule(void) {
-    pm.current_thread = process_get_next_thread();
-    if (pm.current_thread) {
-        pm.current_thread->state = THREAD_RUNNING;
-        pm.current_pid = pm.current_thread->pid;
-        pm.current_tid = pm.current_thread->tid;
+// Charge the tick to the interrupted thread and switch to the next one
+uint32_t process_context_switch(uint32_t esp) {
+    cpu_t *cpu = this_cpu();
+    thread_t *current = cpu->current;
+    if (!current) {
+        return esp;  // Process manager not initialized yet
+    }
+    
+    cpu->ticks++;
+    current->ticks++;
+    process_t *proc = process_get_by_id(current->pid);
+    if (proc) {
+        proc->total_ticks++;
     }
+    
+    return switch_threads(esp, 0);
+}
+
+// Switch away from a thread that yielded or blocked
+uint32_t process_yield_switch(uint32_t esp) {
+    return switch_threads(esp, 1);
+}
+
+// Switch for a reschedule IPI: a woken thread outranks the current one
+uint32_t process_preempt_switch(uint32_t esp) {
+    return switch_threads(esp, 0);
 }
 
-// Context switch (placeholder for actual assembly context switch)
-void process_context_switch(void) {
-    // In a real implementation, this would save current thread state
-    // and restore the next thread's state
-    process_schedule();
+// Thread currently running on this CPU; interrupts are off while
+// reading so the thread cannot migrate between finding its CPU and
+// looking at it
+thread_t* process_current_thread(void) {
+    uint32_t flags = irq_save();
+    thread_t *thread = this_cpu()->current;
+    irq_restore(flags);
+    return thread;
+}
+
+// Give up the CPU; the caller stays runnable unless it marked itself
+// blocked or terminated first
+void thread_yield(void) {
+    asm volatile("int %0" : : "i"(YIELD_VECTOR) : "memory");
+}
+
+// Block the current thread until thread_wake(). Interrupts must be off
+// from the caller's wakeup-condition check until here, so a wakeup
+// cannot slip in between; they are off again when this returns. A waker
+// on another CPU needs the caller's lock, which is only dropped once the
+// thread is marked blocked: a wakeup from then on makes it READY, and the
+// switch below keeps or requeues it instead of losing it.
+// A thread terminated from another CPU in the meantime must not be
+// marked blocked again: it drops the wait-queue entry and timer its
+// caller just set up, which process_terminate() may have cleared
+// already, and switches away for good.
+void thread_block(spinlock_t *lock) {
+    cpu_t *cpu = this_cpu();
+    thread_t *thread = cpu->current;
+    
+    spin_lock(&cpu->run_queue.lock);
+    int running = (thread->state == THREAD_RUNNING);
+    if (running) {
+        thread->state = THREAD_BLOCKED;
+    }
+    spin_unlock(&cpu->run_queue.lock);
+    
+    if (!running) {
+        if (lock) {
+            spin_unlock(lock);
+        }
+        wait_queue_remove(thread);
+        timer_cancel(&thread->timer);
+        thread_yield();  // Never returns: terminated threads are not requeued
+    }
+    
+    process_t *proc = process_get_by_id(thread->pid);
+    if (proc) {
+        proc->state = PROC_BLOCKED;
+    }
+    
+    if (lock) {
+        spin_unlock(lock);
+    }
+    thread_yield();
+    if (lock) {
+        spin_lock(lock);
+    }
+}
+
+// Make a blocked thread runnable again (safe from interrupt handlers).
+// It goes back on its own CPU's run queue, unless that CPU has not
+// finished switching away from it yet (process_finish_switch() queues
+// it then).
+void thread_wake(thread_t *thread) {
+    if (!thread) {
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    cpu_t *cpu = thread_lock_cpu(thread);
+    
+    if (thread->state == THREAD_BLOCKED) {
+        thread->state = THREAD_READY;
+        thread->ready_since = clock_cycles();
+        if (!thread->on_cpu) {
+            thread_class(thread)->enqueue(&cpu->run_queue, thread, SCHED_ENQUEUE_WAKEUP);
+            check_preempt(cpu, thread);
+        }
+        
+        process_t *proc = process_get_by_id(thread->pid);
+        if (proc && proc->state == PROC_BLOCKED) {
+            proc->state = PROC_READY;
+        }
+    }
+    
+    spin_unlock(&cpu->run_queue.lock);
+    irq_restore(flags);
+}
+
+// Timer callback for a thread blocked with a deadline
+static void thread_timeout(void *data) {
+    thread_wake((thread_t *)data);
+}
+
+// Block with the thread's timer armed for the deadline. Whoever gets
+// there first wakes the thread; a still-pending timer means it was not
+// the timer.
+int thread_block_timeout(uint32_t deadline, spinlock_t *lock) {
+    thread_t *thread = process_current_thread();
+    if ((int32_t)(deadline - scheduler_get_ticks()) <= 0) {
+        return 0;  // Already expired
+    }
+    
+    timer_add(&thread->timer, thread_timeout, thread, deadline);
+    thread_block(lock);
+    return timer_cancel(&thread->timer);
+}
+
+// Sleep for at least ms milliseconds; early wakeups go back to sleep
+void thread_sleep_ms(uint32_t ms) {
+    uint32_t deadline = scheduler_get_ticks() + timer_ms_to_ticks(ms);
+    
+    uint32_t flags = irq_save();
+    while (thread_block_timeout(deadline, NULL)) {
+        // Woken before the deadline: sleep out the rest
+    }
+    irq_restore(flags);
 }
 
 // Get process statistics
@@ -279,17 +1140,43 @@ void process_get_stats(process_stats_t *stats) {
         return;
     }
     
-    stats->total_processes = pm.process_count;
+    stats->total_processes = pm.processes.count + pm.terminated;
     stats->running_processes = 0;
     stats->ready_processes = 0;
     stats->blocked_processes = 0;
-    stats->terminated_processes = 0;
+    stats->terminated_processes = pm.terminated;
     stats->total_threads = 0;
     stats->ready_threads = 0;
     stats->running_threads = 0;
     
-    for (uint32_t i = 0; i < pm.process_count; i++) {
-        process_t *proc = &pm.processes[i];
+    // Every CPU ticks at the same rate, so idle time is compared with
+    // the uptime times the CPU count. Scale down first when
+    // idle_ticks * 100 could overflow.
+    stats->uptime_ticks = scheduler_get_ticks();
+    stats->cpu_count = smp_cpu_count();
+    stats->idle_ticks = 0;
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        cpu_t *cpu = smp_get_cpu(c);
+        if (cpu->online) {
+            stats->idle_ticks += cpu->idle->ticks;
+        }
+    }
+    stats->idle_percent = 0;
+    uint32_t total = stats->uptime_ticks * stats->cpu_count;
+    if (total > 0) {
+        stats->idle_percent = (total < 0x1000000) ?
+            stats->idle_ticks * 100 / total :
+            stats->idle_ticks / (total / 100);
+        if (stats->idle_percent > 100) {
+            stats->idle_percent = 100;  // APs tick on their own timers
+        }
+    }
+    
+    for (uint32_t i = 0; i < handle_capacity(&pm.processes); i++) {
+        process_t *proc = (process_t *)handle_at(&pm.processes, i);
+        if (!proc) {
+            continue;
+        }
         
         switch (proc->state) {
             case PROC_RUNNING:
@@ -331,6 +1218,10 @@ void process_print_stats(void) {
     
     console_puts("\n=== Process & Thread Statistics ===\n");
     
+    console_puts("Scheduler:            ");
+    console_puts(sched_class->name);
+    console_puts("\n");
+    
     console_puts("Total Processes:      ");
     itoa(stats.total_processes, buffer);
     console_puts(buffer);
@@ -356,6 +1247,21 @@ void process_print_stats(void) {
     console_puts(buffer);
     console_puts("\n");
     
+    // PID/TID table slots in use and allocated so far
+    console_puts("Table Slots:          ");
+    itoa(pm.processes.count, buffer);
+    console_puts(buffer);
+    console_puts("/");
+    itoa(handle_capacity(&pm.processes), buffer);
+    console_puts(buffer);
+    console_puts(" processes, ");
+    itoa(pm.threads.count, buffer);
+    console_puts(buffer);
+    console_puts("/");
+    itoa(handle_capacity(&pm.threads), buffer);
+    console_puts(buffer);
+    console_puts(" threads\n");
+    
     console_puts("Ready Threads:        ");
     itoa(stats.ready_threads, buffer);
     console_puts(buffer);
@@ -365,6 +1271,45 @@ void process_print_stats(void) {
     itoa(stats.running_threads, buffer);
     console_puts(buffer);
     console_puts("\n");
+    
+    console_puts("Idle Time:            ");
+    itoa(stats.idle_percent, buffer);
+    console_puts(buffer);
+    console_puts("% (");
+    itoa(stats.idle_ticks, buffer);
+    console_puts(buffer);
+    console_puts(" of ");
+    itoa(stats.uptime_ticks, buffer);
+    console_puts(buffer);
+    console_puts(" ticks x ");
+    itoa(stats.cpu_count, buffer);
+    console_puts(buffer);
+    console_puts(" CPUs)\n");
+    
+    // Per-CPU load and balancing
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        cpu_t *cpu = smp_get_cpu(c);
+        if (!cpu->online) {
+            continue;
+        }
+        
+        console_puts("CPU ");
+        itoa(c, buffer);
+        console_puts(buffer);
+        console_puts(": Ticks: ");
+        itoa(cpu->ticks, buffer);
+        console_puts(buffer);
+        console_puts(" | Idle: ");
+        itoa(cpu->idle->ticks, buffer);
+        console_puts(buffer);
+        console_puts(" | Queued: ");
+        itoa(cpu->run_queue.count, buffer);
+        console_puts(buffer);
+        console_puts(" | Stolen: ");
+        itoa(cpu->steals, buffer);
+        console_puts(buffer);
+        console_puts("\n");
+    }
 }
 
 // Print all processes and their threads
@@ -373,8 +1318,11 @@ void process_print_processes(void) {
     
     console_puts("\n=== Processes and Threads ===\n");
     
-    for (uint32_t i = 0; i < pm.process_count; i++) {
-        process_t *proc = &pm.processes[i];
+    for (uint32_t i = 0; i < handle_capacity(&pm.processes); i++) {
+        process_t *proc = (process_t *)handle_at(&pm.processes, i);
+        if (!proc) {
+            continue;
+        }
         
         console_puts("PID ");
         itoa(proc->pid, buffer);
@@ -416,6 +1364,9 @@ void process_print_processes(void) {
                 console_puts(" | Priority: ");
                 itoa(thread->priority, buffer);
                 console_puts(buffer);
+                console_puts(" | Ticks: ");
+                itoa(thread->ticks, buffer);
+                console_puts(buffer);
                 console_puts(" | State: ");
                 
                 switch (thread->state) {
@@ -440,3 +1391,385 @@ void process_print_processes(void) {
         }
     }
 }
+
+// Bucket labels for the wait latency histograms (see SCHED_LAT_BUCKETS)
+static const char *const sched_lat_labels[SCHED_LAT_BUCKETS] = {
+    "<1us", "1-2us", "2-4us", "4-8us", "8-16us", "16-32us", "32-64us",
+    "64-128us", "128-256us", "256-512us", "512us-1ms", "1-2ms", "2-4ms",
+    "4-8ms", "8-16ms", "16-32ms", "32-65ms", "65-131ms", "131-262ms", ">=262ms"
+};
+
+// Print a string padded with spaces to width, on the left for numbers
+static void print_column(const char *text, uint32_t width, int right) {
+    uint32_t len = 0;
+    while (text[len]) {
+        len++;
+    }
+    
+    if (!right) {
+        console_puts(text);
+    }
+    for (; len < width; len++) {
+        console_puts(" ");
+    }
+    if (right) {
+        console_puts(text);
+    }
+}
+
+// Print a number right-aligned in width columns
+static void print_number(uint32_t value, uint32_t width) {
+    char buffer[16];
+    
+    itoa(value, buffer);
+    print_column(buffer, width, 1);
+}
+
+// Convert TSC cycles to microseconds
+static uint64_t cycles_to_us(uint64_t cycles) {
+    return udiv64_32(clock_cycles_to_ns(cycles), 1000, NULL);
+}
+
+// Share of one CPU the thread ran for since its last sample
+static void thread_sample_cpu(thread_t *thread, uint32_t period_us) {
+    uint64_t run = thread->run_cycles;
+    uint64_t ran_us = cycles_to_us(run - thread->sampled_cycles);
+    thread->sampled_cycles = run;
+    
+    uint32_t percent = period_us ? (uint32_t)udiv64_32(ran_us * 100, period_us, NULL) : 0;
+    thread->cpu_percent = (percent > 100) ? 100 : percent;
+}
+
+// Recompute cpu_percent for every thread. Run time is charged at each
+// switch and tick, so a running thread's share lags by at most a tick.
+void process_sample_cpu(void) {
+    uint64_t now = clock_cycles();
+    uint32_t period_us = (uint32_t)cycles_to_us(now - cpu_sampled_at);
+    cpu_sampled_at = now;
+    
+    thread_sample_cpu(&kernel_thread, period_us);
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        if (smp_get_cpu(c)->online) {
+            thread_sample_cpu(&idle_threads[c], period_us);
+        }
+    }
+    
+    for (uint32_t i = 0; i < handle_capacity(&pm.processes); i++) {
+        process_t *proc = (process_t *)handle_at(&pm.processes, i);
+        if (!proc) {
+            continue;
+        }
+        for (uint32_t j = 0; j < proc->thread_count; j++) {
+            if (proc->threads[j]) {
+                thread_sample_cpu(proc->threads[j], period_us);
+            }
+        }
+    }
+}
+
+// One row of the top table
+static void top_print_thread(thread_t *thread, const char *note) {
+    static const char *const states[] = {
+        "CREATED", "READY", "RUNNING", "BLOCKED", "TERMINATED"
+    };
+    
+    print_number(thread->pid, 5);
+    print_number(thread->tid, 6);
+    print_number(thread->priority, 4);
+    print_number(thread->cpu, 4);
+    console_puts("  ");
+    print_column(states[thread->state], 11, 0);
+    print_number(thread->cpu_percent, 4);
+    print_number((uint32_t)udiv64_32(cycles_to_us(thread->run_cycles), 1000, NULL), 9);
+    print_number((uint32_t)udiv64_32(cycles_to_us(thread->wait_cycles), 1000, NULL), 9);
+    print_number(thread->voluntary_switches, 7);
+    print_number(thread->involuntary_switches, 7);
+    if (note) {
+        console_puts("  ");
+        console_puts(note);
+    }
+    console_puts("\n");
+}
+
+// Per-thread CPU accounting, sampled now
+void process_print_top(void) {
+    process_sample_cpu();
+    
+    console_puts("  PID   TID PRI CPU  STATE      CPU%   RUN ms  WAIT ms    VOL  INVOL\n");
+    top_print_thread(&kernel_thread, "shell");
+    for (uint32_t i = 0; i < handle_capacity(&pm.processes); i++) {
+        process_t *proc = (process_t *)handle_at(&pm.processes, i);
+        if (!proc) {
+            continue;
+        }
+        if (proc->state == PROC_TERMINATED) {
+            continue;
+        }
+        for (uint32_t j = 0; j < proc->thread_count; j++) {
+            if (proc->threads[j]) {
+                top_print_thread(proc->threads[j], NULL);
+            }
+        }
+    }
+    
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        if (smp_get_cpu(c)->online) {
+            top_print_thread(&idle_threads[c], "idle");
+        }
+    }
+}
+
+// Wait latency histograms: one column per CPU and the combined count,
+// then percentiles read off the combined buckets
+void process_print_schedlat(void) {
+    char buffer[16];
+    uint32_t totals[SCHED_LAT_BUCKETS];
+    uint32_t samples = 0;
+    
+    console_puts("\n=== Run Queue Wait Latency ===\n");
+    print_column("Wait", 12, 0);
+    print_column("Total", 8, 1);
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        if (smp_get_cpu(c)->online) {
+            itoa(c, buffer);
+            console_puts("   CPU");
+            console_puts(buffer);
+        }
+    }
+    console_puts("\n");
+    
+    for (uint32_t b = 0; b < SCHED_LAT_BUCKETS; b++) {
+        totals[b] = 0;
+        for (uint32_t c = 0; c < MAX_CPUS; c++) {
+            totals[b] += smp_get_cpu(c)->wait_hist[b];
+        }
+        samples += totals[b];
+        if (totals[b] == 0) {
+            continue;
+        }
+        
+        print_column(sched_lat_labels[b], 12, 0);
+        print_number(totals[b], 8);
+        for (uint32_t c = 0; c < MAX_CPUS; c++) {
+            cpu_t *cpu = smp_get_cpu(c);
+            if (cpu->online) {
+                print_number(cpu->wait_hist[b], 7);
+            }
+        }
+        console_puts("\n");
+    }
+    
+    console_puts("Samples: ");
+    itoa(samples, buffer);
+    console_puts(buffer);
+    if (samples) {
+        // Bucket where the running count first reaches 50% / 99%
+        uint32_t seen = 0;
+        uint32_t p50 = 0, p99 = 0;
+        for (uint32_t b = 0; b < SCHED_LAT_BUCKETS; b++) {
+            if (seen * 100 < samples * 50) {
+                p50 = b;
+            }
+            if (seen * 100 < samples * 99) {
+                p99 = b;
+            }
+            seen += totals[b];
+        }
+        console_puts(" | p50: ");
+        console_puts(sched_lat_labels[p50]);
+        console_puts(" | p99: ");
+        console_puts(sched_lat_labels[p99]);
+    }
+    console_puts("\n");
+}
+
+// EDF bandwidth reserved per CPU, then jobs and deadline misses per thread
+void process_print_rtstat(void) {
+    char buffer[16];
+    uint32_t threads = 0;
+    uint32_t misses = 0;
+    
+    console_puts("\n=== Real-Time (EDF) Threads ===\n");
+    console_puts("Bandwidth:");
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        cpu_t *cpu = smp_get_cpu(c);
+        if (!cpu->online) {
+            continue;
+        }
+        console_puts(" CPU");
+        itoa(c, buffer);
+        console_puts(buffer);
+        console_puts(" ");
+        itoa(cpu->rt_bandwidth / 10000, buffer);
+        console_puts(buffer);
+        console_puts("%");
+    }
+    console_puts(" (limit ");
+    itoa(EDF_BANDWIDTH_PPM / 10000, buffer);
+    console_puts(buffer);
+    console_puts("%)\n");
+    
+    print_column("TID", 5, 1);
+    print_column("CPU", 4, 1);
+    print_column("Run", 6, 1);
+    print_column("Period", 7, 1);
+    print_column("Dline", 6, 1);
+    print_column("Jobs", 8, 1);
+    print_column("Misses", 7, 1);
+    print_column("Thrott", 7, 1);
+    print_column("MaxLate", 8, 1);
+    console_puts("\n");
+    
+    for (uint32_t i = 0; i < handle_capacity(&pm.processes); i++) {
+        process_t *proc = (process_t *)handle_at(&pm.processes, i);
+        if (!proc) {
+            continue;
+        }
+        for (uint32_t j = 0; j < proc->thread_count; j++) {
+            thread_t *thread = proc->threads[j];
+            if (!thread || thread->edf.params.runtime_ms == 0) {
+                continue;
+            }
+            
+            edf_state_t *edf = &thread->edf;
+            print_number(thread->tid, 5);
+            print_number(thread->cpu, 4);
+            print_number(edf->params.runtime_ms, 6);
+            print_number(edf->params.period_ms, 7);
+            print_number(edf->params.deadline_ms, 6);
+            print_number(edf->jobs, 8);
+            print_number(edf->misses, 7);
+            print_number(edf->throttles, 7);
+            print_number(edf->max_lateness * (1000 / TIMER_HZ), 6);
+            console_puts("ms");
+            if (thread->state == THREAD_TERMINATED) {
+                console_puts(" (exited)");
+            }
+            console_puts("\n");
+            
+            threads++;
+            misses += edf->misses;
+        }
+    }
+    
+    if (threads == 0) {
+        console_puts("No real-time threads\n");
+        return;
+    }
+    console_puts("Deadline misses: ");
+    itoa(misses, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+}
+
+// Single sorted ready list the run queues replaced, kept as the
+// benchmark baseline: insertion walks to the thread's priority, and a
+// pick rotates the head to the tail
+static void sorted_list_insert(thread_t **list, thread_t *thread) {
+    thread_t *current = *list;
+    thread_t *prev = NULL;
+    while (current && current->priority >= thread->priority) {
+        prev = current;
+        current = current->next;
+    }
+    
+    thread->next = current;
+    if (!prev) {
+        *list = thread;
+    } else {
+        prev->next = thread;
+    }
+}
+
+// Baseline pick: take the head and move it to the back of the list
+static thread_t *sorted_list_pick(thread_t **list) {
+    thread_t *next_thread = *list;
+    if (next_thread && next_thread->next) {
+        *list = next_thread->next;
+        
+        thread_t *current = *list;
+        while (current->next) {
+            current = current->next;
+        }
+        current->next = next_thread;
+        next_thread->next = NULL;
+    }
+    return next_thread;
+}
+
+// Print the cycles per pick-next + requeue for the priority run queues
+// and the old sorted list, with 32 and 256 runnable threads
+void process_sched_benchmark(void) {
+    static const uint32_t counts[] = { 32, 256 };
+    const uint32_t switches = 1000;  // Switches per measurement
+    char buffer[16];
+    
+    thread_t *threads = (thread_t *)malloc(256 * sizeof(thread_t));
+    if (!threads) {
+        console_puts("Error: Not enough memory for benchmark threads\n");
+        return;
+    }
+    
+    console_puts("\n=== Scheduler Benchmark (cycles/switch) ===\n");
+    
+    for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t n = counts[c];
+        
+        // Spread the threads over every priority level
+        run_queue_t rq = {0};
+        for (uint32_t i = 0; i < n; i++) {
+            threads[i].priority = i % THREAD_PRIORITY_LEVELS;
+            run_queue_push(&rq, &threads[i]);
+        }
+        
+        uint32_t flags = irq_save();
+        uint64_t start = rdtsc();
+        for (uint32_t i = 0; i < switches; i++) {
+            run_queue_push(&rq, run_queue_pop(&rq));
+        }
+        uint32_t queue_cycles = (uint32_t)(rdtsc() - start);
+        
+        // Fair timeline: pick the leftmost, charge it a tick, requeue
+        run_queue_t timeline = {0};
+        for (uint32_t i = 0; i < n; i++) {
+            threads[i].vruntime = 0;
+            fair_sched_class.enqueue(&timeline, &threads[i], 0);
+        }
+        
+        start = rdtsc();
+        for (uint32_t i = 0; i < switches; i++) {
+            thread_t *thread = fair_sched_class.pick_next(&timeline);
+            fair_sched_class.charge(&timeline, thread, CLOCK_TICK_NS);
+            fair_sched_class.enqueue(&timeline, thread, 0);
+        }
+        uint32_t fair_cycles = (uint32_t)(rdtsc() - start);
+        
+        thread_t *list = NULL;
+        for (uint32_t i = 0; i < n; i++) {
+            sorted_list_insert(&list, &threads[i]);
+        }
+        
+        start = rdtsc();
+        for (uint32_t i = 0; i < switches; i++) {
+            sorted_list_pick(&list);
+        }
+        uint32_t list_cycles = (uint32_t)(rdtsc() - start);
+        irq_restore(flags);
+        
+        console_puts("Threads: ");
+        itoa(n, buffer);
+        console_puts(buffer);
+        console_puts(n < 100 ? "  | run queues: " : " | run queues: ");
+        itoa(queue_cycles / switches, buffer);
+        console_puts(buffer);
+        console_puts(" | fair tree: ");
+        itoa(fair_cycles / switches, buffer);
+        console_puts(buffer);
+        console_puts(" | sorted list: ");
+        itoa(list_cycles / switches, buffer);
+        console_puts(buffer);
+        console_puts("\n");
+    }
+    
+    free(threads);
+}
@@ -3,11 +3,36 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "paging.h"
+#include "timer.h"
+#include "spinlock.h"
+#include "rbtree.h"
+#include "handle.h"
 
-// Process and Thread limits
-#define MAX_PROCESSES 8
-#define MAX_THREADS_PER_PROCESS 4
+// Process and Thread limits. PIDs and TIDs are handles (handle.h) into
+// tables that grow on demand up to these sizes.
+#define MAX_PROCESSES 256
+#define MAX_THREADS 1024                // Idle threads included
+#define MAX_THREADS_PER_PROCESS 64
+#define PROCESS_THREADS_INITIAL 4       // First size of a process's thread list
 #define THREAD_STACK_SIZE 4096
+#define THREAD_PRIORITY_MAX 10         // Priorities run from 0 (low) to 10 (high)
+#define THREAD_PRIORITY_LEVELS (THREAD_PRIORITY_MAX + 1)
+#define YIELD_VECTOR 0x30              // Software interrupt for voluntary switches
+#define SCHED_LAT_BUCKETS 20           // Wait latency histogram: <1us, then [2^(i-1), 2^i) us, last open-ended
+
+// Fair class tuning (virtual nanoseconds)
+#define FAIR_WEIGHT_DEFAULT 1024       // Weight of priority 5; vruntime advances at wall-clock rate
+#define FAIR_SLEEPER_CREDIT_NS 10000000   // How far behind min_vruntime a waking thread may be placed
+#define FAIR_WAKEUP_GRANULARITY_NS 1000000 // Lead a woken thread needs to preempt the running one
+
+// EDF admission: share of each CPU real-time threads may reserve; the
+// rest is left to normal threads
+#define EDF_BANDWIDTH_PPM 950000
+
+// sched_class_t enqueue flags
+#define SCHED_ENQUEUE_NEW 0x1          // Thread never ran
+#define SCHED_ENQUEUE_WAKEUP 0x2       // Thread was blocked
 
 // Process and Thread states
 typedef enum {
@@ -26,12 +51,44 @@ typedef enum {
     THREAD_TERMINATED
 } thread_state_t;
 
+// Register frame isr_timer saves on a thread's stack; a thread's esp
+// points at one of these whenever it is not running
+typedef struct {
+    uint32_t gs, fs, es, ds;           // Segment registers
+    uint32_t edi, esi, ebp, esp_dummy; // pusha block (esp is not restored)
+    uint32_t ebx, edx, ecx, eax;
+    uint32_t eip, cs, eflags;          // Pushed by the CPU on the interrupt
+} thread_frame_t;
+
+// Real-time parameters of an EDF thread: every period_ms it may run
+// for runtime_ms, and each such job is due deadline_ms after its release
+typedef struct {
+    uint32_t runtime_ms;
+    uint32_t period_ms;
+    uint32_t deadline_ms;              // runtime_ms <= deadline_ms <= period_ms
+} edf_params_t;
+
+// EDF state of a thread; params.runtime_ms is 0 for normal threads
+typedef struct {
+    edf_params_t params;
+    uint32_t admitted;                 // Holds bandwidth on its CPU (cpu_t.rt_bandwidth)
+    int64_t budget_ns;                 // Runtime left before the thread is throttled
+    uint32_t release;                  // Tick the current job was released
+    uint32_t job_deadline;             // Tick the current job is due
+    uint32_t deadline;                 // EDF order; a throttle pushes it back a period
+    timer_t replenish;                 // Ends a throttle
+    uint32_t jobs;                     // Jobs completed
+    uint32_t misses;                   // Jobs completed after their job_deadline
+    uint32_t throttles;                // Times the budget ran out
+    uint32_t max_lateness;             // Worst miss, in ticks
+} edf_state_t;
+
 // Thread structure
 typedef struct thread {
     uint32_t tid;                      // Thread ID
     uint32_t pid;                      // Parent Process ID
     thread_state_t state;              // Thread state
-    uint32_t esp;                      // Stack pointer
+    uint32_t esp;                      // Saved frame (thread_frame_t) while switched out
     uint32_t ebp;                      // Base pointer
     uint32_t eip;                      // Instruction pointer
     uint8_t *stack;                    // Stack memory
@@ -39,55 +96,165 @@ typedef struct thread {
     uint32_t ticks;                    // Execution ticks
     uint32_t priority;                 // Thread priority (0=low, 10=high)
     void (*entry_point)(void);         // Thread entry point
-    struct thread *next;               // Linked list for scheduling
+    struct thread *next;               // Next thread in its run queue
+    struct thread *prev;               // Previous thread in its run queue
+    timer_t timer;                     // Sleep/timeout timer (pending while armed)
+    struct wait_queue *wait_queue;     // Wait queue the thread is blocked on
+    struct thread *wait_next;          // Next waiter on that queue
+    struct thread *wait_prev;          // Previous waiter on that queue
+    uint32_t cpu;                      // CPU whose run queue owns the thread
+    volatile uint32_t on_cpu;          // Set while a CPU runs on (or is leaving) its stack
+    uint32_t pinned;                   // Never stolen by another CPU
+    uint64_t run_cycles;               // TSC cycles spent running
+    uint64_t wait_cycles;              // TSC cycles spent ready on a run queue
+    uint64_t switched_in;              // TSC when it last started running
+    uint64_t ready_since;              // TSC when it last became ready
+    uint64_t sampled_cycles;           // run_cycles at the last process_sample_cpu()
+    uint32_t cpu_percent;              // Share of one CPU over the last sample period
+    uint32_t voluntary_switches;       // Blocked, slept, yielded or exited
+    uint32_t involuntary_switches;     // Preempted by the tick or a reschedule IPI
+    uint64_t vruntime;                 // Fair class: weighted run time, in ns
+    rb_node_t run_node;                // Node in the run queue's timeline (fair) or deadlines (EDF)
+    edf_state_t edf;                   // Real-time parameters and state
 } thread_t;
 
 // Process structure
 typedef struct {
     uint32_t pid;                      // Process ID
+    uint32_t parent_pid;               // Process this one was forked from (0 if none)
     process_state_t state;             // Process state
-    void *memory_start;                // Process memory start
+    void *memory_start;                // Process memory start (virtual)
     uint32_t memory_size;              // Process memory size
+    address_space_t *address_space;    // Page directory and demand-zero region
     thread_t *main_thread;             // Main thread
-    thread_t *threads[MAX_THREADS_PER_PROCESS];  // Thread list
+    thread_t **threads;                // Thread list, doubled when full
     uint32_t thread_count;             // Number of threads
-    uint32_t created_ticks;            // Creation time
-    uint32_t terminated_ticks;         // Termination time
+    uint32_t thread_capacity;          // Entries allocated in threads
+    uint64_t created_ns;               // Creation time (clock_monotonic_ns)
     uint32_t total_ticks;              // Total execution time
 } process_t;
 
-// Process and Thread management structure
+// Ready threads of one CPU, in whichever order the scheduling class
+// keeps them: the priority class uses one FIFO per priority and a bitmap
+// of non-empty levels, the fair class a tree sorted by vruntime. The
+// lock also covers the state, cpu and on_cpu of every thread belonging
+// to the CPU.
+typedef struct {
+    thread_t *head[THREAD_PRIORITY_LEVELS];
+    thread_t *tail[THREAD_PRIORITY_LEVELS];
+    uint32_t bitmap;                   // Bit p set when head[p] is non-NULL
+    rb_root_t timeline;                // Fair class: threads by vruntime
+    uint64_t min_vruntime;             // Fair class: never decreases; new and waking threads start near it
+    rb_root_t deadlines;               // EDF threads by deadline, run before everything else
+    uint32_t count;                    // Threads queued
+    spinlock_t lock;
+} run_queue_t;
+
+// Scheduling class: how run queues order threads and when a queued
+// thread takes over the CPU. One class is chosen at boot and used by
+// every CPU; all hooks run with the run queue locked.
 typedef struct {
-    process_t processes[MAX_PROCESSES];
-    uint32_t process_count;
-    uint32_t current_pid;
-    uint32_t current_tid;
-    uint32_t next_pid;
-    uint32_t next_tid;
-    thread_t *ready_queue;             // Head of ready thread queue
-    thread_t *current_thread;          // Currently executing thread
+    const char *name;
+    void (*enqueue)(run_queue_t *rq, thread_t *thread, uint32_t flags);
+    void (*dequeue)(run_queue_t *rq, thread_t *thread);    // No-op if not queued
+    thread_t *(*pick_next)(run_queue_t *rq);               // Dequeue the thread to run next
+    thread_t *(*steal)(run_queue_t *from, run_queue_t *to); // Dequeue a thread that may migrate
+    void (*charge)(run_queue_t *rq, thread_t *thread, uint64_t ns);  // Thread ran for ns
+    int (*tick_preempt)(run_queue_t *rq, thread_t *current);         // Queued work should run instead
+    int (*wakeup_preempt)(thread_t *current, thread_t *thread);      // Woken thread should run now
+} sched_class_t;
+
+// The boot-time classes for normal threads: strict priority with round
+// robin inside a level (default), and weighted fair sharing by virtual
+// run time. Threads with EDF parameters always use the EDF class, which
+// runs ahead of either.
+extern const sched_class_t prio_sched_class;
+extern const sched_class_t fair_sched_class;
+extern const sched_class_t edf_sched_class;
+
+// Process and Thread management structure. The run queues and running
+// threads are per CPU (cpu_t in smp.h).
+typedef struct {
+    handle_table_t processes;          // PID -> process_t
+    handle_table_t threads;            // TID -> thread_t
+    uint32_t terminated;               // Processes terminated (and reclaimed) so far
 } process_manager_t;
 
 // Initialize process manager
 void process_manager_init(void);
 
+// Choose the scheduling class by name ("prio" or "fair"); only before
+// process_manager_init(). Returns 0, or -1 for an unknown name.
+int process_set_sched_class(const char *name);
+const char *process_sched_class_name(void);
+
 // Process management
 uint32_t process_create(void (*entry)(void), uint32_t memory_size, const char *name);
+uint32_t process_fork(uint32_t pid);
+
+// Same as process_create(), with an EDF main thread; 0 also when
+// admission control rejects it
+uint32_t process_create_deadline(void (*entry)(void), uint32_t memory_size, const char *name, const edf_params_t *params);
+
+// Terminating a process frees it and its threads: the PID and TIDs stop
+// resolving, and their table slots go to later processes and threads
 int process_terminate(uint32_t pid);
 process_t* process_get_by_id(uint32_t pid);
 process_state_t process_get_state(uint32_t pid);
 
 // Thread management
 uint32_t thread_create(uint32_t pid, void (*entry)(void), uint32_t priority);
+uint32_t thread_create_on(uint32_t pid, void (*entry)(void), uint32_t priority, uint32_t cpu);
+uint32_t thread_create_deadline(uint32_t pid, void (*entry)(void), const edf_params_t *params);
 int thread_terminate(uint32_t tid);
 thread_t* thread_get_by_id(uint32_t tid);
 thread_state_t thread_get_state(uint32_t tid);
 void thread_set_priority(uint32_t tid, uint32_t priority);
 
-// Scheduling
-void process_schedule(void);
-thread_t* process_get_next_thread(void);
-void process_context_switch(void);
+// Timer-driven switch: takes the interrupted thread's saved frame and
+// returns the frame of the thread to resume (called from scheduler_schedule)
+uint32_t process_context_switch(uint32_t esp);
+
+// Voluntary switch from isr_yield; the current thread is not charged a tick
+uint32_t process_yield_switch(uint32_t esp);
+
+// Preempting switch from isr_resched (not charged a tick either)
+uint32_t process_preempt_switch(uint32_t esp);
+
+// Called by the switching ISRs once on the new thread's stack: requeues
+// the thread switched away from, which no CPU may pick up before this
+void process_finish_switch(void);
+
+// Turn the calling application processor into its idle thread (never returns)
+void process_cpu_start(void);
+
+// Blocking: thread_block() must be called with interrupts off and
+// returns once another context has called thread_wake() on the thread.
+// lock, if not NULL, is the spinlock the caller checked its wakeup
+// condition under; it is released while blocked and held again on return.
+thread_t* process_current_thread(void);
+void thread_yield(void);
+void thread_block(spinlock_t *lock);
+void thread_wake(thread_t *thread);
+
+// thread_block() that also wakes at an absolute tick deadline (same
+// rules); returns 0 once the deadline passed, 1 if woken first
+int thread_block_timeout(uint32_t deadline, spinlock_t *lock);
+
+// Sleep for at least ms milliseconds (rounded up to whole ticks)
+void thread_sleep_ms(uint32_t ms);
+
+// EDF threads: end the current job and sleep until the next release
+// (other threads just yield)
+void thread_wait_period(void);
+
+// EDF admission control: reserve the parameters' density on the online
+// CPU with the most room, returning its index, or -1 if they are invalid
+// or fit nowhere. edf_init_thread() hands the reservation to a thread,
+// pinned to that CPU; edf_release() gives it back.
+int edf_admit(const edf_params_t *params);
+void edf_init_thread(thread_t *thread, const edf_params_t *params, uint32_t cpu);
+void edf_release(thread_t *thread);
 
 // Statistics
 typedef struct {
@@ -99,10 +266,29 @@ typedef struct {
     uint32_t total_threads;
     uint32_t ready_threads;
     uint32_t running_threads;
+    uint32_t uptime_ticks;             // Timer ticks since boot
+    uint32_t cpu_count;                // CPUs online
+    uint32_t idle_ticks;               // Ticks spent in the idle threads, all CPUs
+    uint32_t idle_percent;             // idle_ticks as a share of uptime on every CPU
 } process_stats_t;
 
 void process_get_stats(process_stats_t *stats);
 void process_print_stats(void);
 void process_print_processes(void);
 
+// Recompute every thread's cpu_percent over the time since the last
+// call, then print the per-thread accounting table (top)
+void process_sample_cpu(void);
+void process_print_top(void);
+
+// Run-queue wait latency histograms, per CPU and combined
+void process_print_schedlat(void);
+
+// EDF bandwidth per CPU and per-thread jobs, misses and throttles
+void process_print_rtstat(void);
+
+// Cost of a pick-next + requeue with 32 and 256 runnable threads, for
+// the priority run queues, the fair timeline and a sorted list
+void process_sched_benchmark(void);
+
 #endif // PROCESS_H
@@ -0,0 +1,238 @@
+#include "rbtree.h"
+
+// Replace subtree u with subtree v in u's parent
+static void rb_transplant(rb_root_t *tree, rb_node_t *u, rb_node_t *v) {
+    if (!u->parent) {
+        tree->root = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    if (v) {
+        v->parent = u->parent;
+    }
+}
+
+// x's right child takes x's place; x becomes its left child
+static void rb_rotate_left(rb_root_t *tree, rb_node_t *x) {
+    rb_node_t *y = x->right;
+    
+    x->right = y->left;
+    if (y->left) {
+        y->left->parent = x;
+    }
+    rb_transplant(tree, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+// x's left child takes x's place; x becomes its right child
+static void rb_rotate_right(rb_root_t *tree, rb_node_t *x) {
+    rb_node_t *y = x->left;
+    
+    x->left = y->right;
+    if (y->right) {
+        y->right->parent = x;
+    }
+    rb_transplant(tree, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+static int rb_is_black(const rb_node_t *node) {
+    return !node || node->color == RB_BLACK;
+}
+
+// Insert as a red leaf, then recolour and rotate until no red node has a
+// red parent
+void rb_insert(rb_root_t *tree, rb_node_t *node, rb_less_t less) {
+    rb_node_t **link = &tree->root;
+    rb_node_t *parent = NULL;
+    int leftmost = 1;
+    
+    while (*link) {
+        parent = *link;
+        if (less(node, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->color = RB_RED;
+    *link = node;
+    if (leftmost) {
+        tree->leftmost = node;
+    }
+    
+    // The root is black, so a red parent always has a parent
+    while ((parent = node->parent) && parent->color == RB_RED) {
+        rb_node_t *grand = parent->parent;
+        
+        if (parent == grand->left) {
+            rb_node_t *uncle = grand->right;
+            if (!rb_is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grand->color = RB_RED;
+                node = grand;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            grand->color = RB_RED;
+            rb_rotate_right(tree, grand);
+        } else {
+            rb_node_t *uncle = grand->left;
+            if (!rb_is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grand->color = RB_RED;
+                node = grand;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            grand->color = RB_RED;
+            rb_rotate_left(tree, grand);
+        }
+    }
+    tree->root->color = RB_BLACK;
+}
+
+// Restore the black heights after a black node was removed above x
+// (x may be NULL, hence the separate parent)
+static void rb_erase_fixup(rb_root_t *tree, rb_node_t *x, rb_node_t *parent) {
+    while (x != tree->root && rb_is_black(x)) {
+        if (x == parent->left) {
+            rb_node_t *sibling = parent->right;
+            if (sibling->color == RB_RED) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_left(tree, parent);
+                sibling = parent->right;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (rb_is_black(sibling->right)) {
+                sibling->left->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_right(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->right->color = RB_BLACK;
+            rb_rotate_left(tree, parent);
+        } else {
+            rb_node_t *sibling = parent->left;
+            if (sibling->color == RB_RED) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_right(tree, parent);
+                sibling = parent->left;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if (rb_is_black(sibling->left)) {
+                sibling->right->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_left(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->left->color = RB_BLACK;
+            rb_rotate_right(tree, parent);
+        }
+        x = tree->root;
+    }
+    
+    if (x) {
+        x->color = RB_BLACK;
+    }
+}
+
+// Unlink a node; one with two children is replaced by its successor
+void rb_erase(rb_root_t *tree, rb_node_t *node) {
+    rb_node_t *x;
+    rb_node_t *parent;
+    uint32_t removed_color = node->color;
+    
+    if (tree->leftmost == node) {
+        tree->leftmost = rb_next(node);
+    }
+    
+    if (!node->left) {
+        x = node->right;
+        parent = node->parent;
+        rb_transplant(tree, node, node->right);
+    } else if (!node->right) {
+        x = node->left;
+        parent = node->parent;
+        rb_transplant(tree, node, node->left);
+    } else {
+        rb_node_t *next = node->right;
+        while (next->left) {
+            next = next->left;
+        }
+        
+        removed_color = next->color;
+        x = next->right;
+        if (next->parent == node) {
+            parent = next;
+        } else {
+            parent = next->parent;
+            rb_transplant(tree, next, next->right);
+            next->right = node->right;
+            next->right->parent = next;
+        }
+        rb_transplant(tree, node, next);
+        next->left = node->left;
+        next->left->parent = next;
+        next->color = node->color;
+    }
+    
+    if (removed_color == RB_BLACK) {
+        rb_erase_fixup(tree, x, parent);
+    }
+    rb_clear_node(node);
+}
+
+// Leftmost node of the right subtree, else the first ancestor reached
+// from its left
+rb_node_t *rb_next(const rb_node_t *node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t *)node;
+    }
+    
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
@@ -0,0 +1,60 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+// Intrusive red-black tree node: embed one in the object and get back
+// to the object with rb_entry()
+typedef struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    uint32_t color;
+} rb_node_t;
+
+// Tree root with the leftmost (smallest) node cached, so finding the
+// minimum is O(1)
+typedef struct {
+    rb_node_t *root;
+    rb_node_t *leftmost;
+} rb_root_t;
+
+// Ordering for rb_insert(): nonzero when a sorts before b
+typedef int (*rb_less_t)(const rb_node_t *a, const rb_node_t *b);
+
+#define rb_entry(ptr, type, member) ((type *)((uint8_t *)(ptr) - offsetof(type, member)))
+
+// Empty tree
+static inline void rb_init(rb_root_t *tree) {
+    tree->root = NULL;
+    tree->leftmost = NULL;
+}
+
+// Mark a node as not in any tree; rb_linked() tells the two apart
+static inline void rb_clear_node(rb_node_t *node) {
+    node->parent = node;
+}
+
+static inline int rb_linked(const rb_node_t *node) {
+    return node->parent != node;
+}
+
+// Smallest node, or NULL when empty
+static inline rb_node_t *rb_first(const rb_root_t *tree) {
+    return tree->leftmost;
+}
+
+// Insert a node; nodes comparing equal keep insertion order
+void rb_insert(rb_root_t *tree, rb_node_t *node, rb_less_t less);
+
+// Remove a node (which must be in the tree) and clear it
+void rb_erase(rb_root_t *tree, rb_node_t *node);
+
+// In-order successor, or NULL
+rb_node_t *rb_next(const rb_node_t *node);
+
+#endif // RBTREE_H
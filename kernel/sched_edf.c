@@ -0,0 +1,226 @@
+#include "process.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "timer.h"
+#include "cpu.h"
+#include "smp.h"
+#include "rbtree.h"
+
+// Guards cpu_t.rt_bandwidth on every CPU
+static spinlock_t edf_lock = SPINLOCK_INIT;
+
+// Tick counts wrap, so compare through the signed difference
+static int tick_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+// Deadline order: earliest first, FIFO among equals
+static int edf_less(const rb_node_t *a, const rb_node_t *b) {
+    return tick_before(rb_entry(a, thread_t, run_node)->edf.deadline,
+                       rb_entry(b, thread_t, run_node)->edf.deadline);
+}
+
+// Thread with the earliest deadline, or NULL
+static thread_t *edf_first(run_queue_t *rq) {
+    rb_node_t *node = rb_first(&rq->deadlines);
+    return node ? rb_entry(node, thread_t, run_node) : NULL;
+}
+
+// Share of a CPU the parameters need, in parts per million. Dividing by
+// the deadline rather than the period keeps the test sufficient when
+// deadlines are shorter than periods.
+static uint32_t edf_density(const edf_params_t *params) {
+    return (uint32_t)udiv64_32((uint64_t)params->runtime_ms * 1000000, params->deadline_ms, NULL);
+}
+
+// Worst fit: the CPU with the most room left, so reservations spread
+// out and leave each CPU as much slack as possible
+int edf_admit(const edf_params_t *params) {
+    if (!params || params->runtime_ms == 0 || params->runtime_ms > params->deadline_ms ||
+        params->deadline_ms > params->period_ms) {
+        return -1;
+    }
+    
+    uint32_t density = edf_density(params);
+    int best = -1;
+    
+    uint32_t flags = spin_lock_irqsave(&edf_lock);
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        cpu_t *cpu = smp_get_cpu(i);
+        if (!cpu->online || cpu->rt_bandwidth + density > EDF_BANDWIDTH_PPM) {
+            continue;
+        }
+        if (best < 0 || cpu->rt_bandwidth < smp_get_cpu(best)->rt_bandwidth) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        smp_get_cpu(best)->rt_bandwidth += density;
+    }
+    spin_unlock_irqrestore(&edf_lock, flags);
+    
+    return best;
+}
+
+// Give a thread's reservation back to its CPU (once)
+void edf_release(thread_t *thread) {
+    uint32_t flags = spin_lock_irqsave(&edf_lock);
+    if (thread->edf.admitted) {
+        smp_get_cpu(thread->cpu)->rt_bandwidth -= edf_density(&thread->edf.params);
+        thread->edf.admitted = 0;
+    }
+    spin_unlock_irqrestore(&edf_lock, flags);
+}
+
+// Set up a new thread's first job, released now, on the CPU edf_admit()
+// reserved for it
+void edf_init_thread(thread_t *thread, const edf_params_t *params, uint32_t cpu) {
+    edf_state_t *edf = &thread->edf;
+    
+    edf->params = *params;
+    edf->admitted = 1;
+    edf->budget_ns = (int64_t)params->runtime_ms * 1000000;
+    edf->release = scheduler_get_ticks();
+    edf->job_deadline = edf->release + timer_ms_to_ticks(params->deadline_ms);
+    edf->deadline = edf->job_deadline;
+    edf->replenish.pending = 0;
+    edf->jobs = 0;
+    edf->misses = 0;
+    edf->throttles = 0;
+    edf->max_lateness = 0;
+    
+    thread->cpu = cpu;
+    thread->pinned = 1;
+}
+
+// Full budget and a deadline one relative deadline from now
+static void edf_reset(edf_state_t *edf) {
+    edf->deadline = scheduler_get_ticks() + timer_ms_to_ticks(edf->params.deadline_ms);
+    edf->budget_ns = (int64_t)edf->params.runtime_ms * 1000000;
+}
+
+// Timer callback ending a throttle: the next period's budget, due a
+// period later
+static void edf_replenish(void *data) {
+    thread_t *thread = (thread_t *)data;
+    thread->edf.budget_ns = (int64_t)thread->edf.params.runtime_ms * 1000000;
+    thread->edf.deadline += timer_ms_to_ticks(thread->edf.params.period_ms);
+    thread_wake(thread);
+}
+
+// A thread waking with no budget or past its deadline could not finish
+// in time on what it has left; it starts over as if just released (the
+// constant bandwidth server rule), so it never exceeds its reservation
+static void edf_enqueue(run_queue_t *rq, thread_t *thread, uint32_t flags) {
+    edf_state_t *edf = &thread->edf;
+    if ((flags & SCHED_ENQUEUE_WAKEUP) &&
+        (edf->budget_ns <= 0 || !tick_before(scheduler_get_ticks(), edf->deadline))) {
+        edf_reset(edf);
+    }
+    
+    rb_insert(&rq->deadlines, &thread->run_node, edf_less);
+    rq->count++;
+}
+
+static void edf_dequeue(run_queue_t *rq, thread_t *thread) {
+    if (!rb_linked(&thread->run_node)) {
+        return;  // Not queued
+    }
+    rb_erase(&rq->deadlines, &thread->run_node);
+    rq->count--;
+}
+
+// Earliest deadline
+static thread_t *edf_pick_next(run_queue_t *rq) {
+    thread_t *thread = edf_first(rq);
+    if (thread) {
+        edf_dequeue(rq, thread);
+    }
+    return thread;
+}
+
+// Reservations are per CPU, so real-time threads never migrate
+static thread_t *edf_steal(run_queue_t *from, run_queue_t *to) {
+    (void)from;
+    (void)to;
+    return NULL;
+}
+
+// Spend budget. A thread that runs out while still runnable is throttled
+// until its deadline, when edf_replenish() refills it for the next
+// period; past the deadline already, it just starts over.
+static void edf_charge(run_queue_t *rq, thread_t *thread, uint64_t ns) {
+    (void)rq;
+    edf_state_t *edf = &thread->edf;
+    
+    edf->budget_ns -= (int64_t)ns;
+    if (edf->budget_ns > 0 || thread->state != THREAD_READY) {
+        return;
+    }
+    
+    edf->throttles++;
+    if (tick_before(scheduler_get_ticks(), edf->deadline)) {
+        thread->state = THREAD_BLOCKED;
+        timer_add(&edf->replenish, edf_replenish, thread, edf->deadline);
+    } else {
+        edf_reset(edf);
+    }
+}
+
+// At a tick the running thread gives way to an earlier deadline
+static int edf_tick_preempt(run_queue_t *rq, thread_t *current) {
+    thread_t *first = edf_first(rq);
+    return first && tick_before(first->edf.deadline, current->edf.deadline);
+}
+
+// Same for a woken thread
+static int edf_wakeup_preempt(thread_t *current, thread_t *thread) {
+    return tick_before(thread->edf.deadline, current->edf.deadline);
+}
+
+const sched_class_t edf_sched_class = {
+    .name = "edf",
+    .enqueue = edf_enqueue,
+    .dequeue = edf_dequeue,
+    .pick_next = edf_pick_next,
+    .steal = edf_steal,
+    .charge = edf_charge,
+    .tick_preempt = edf_tick_preempt,
+    .wakeup_preempt = edf_wakeup_preempt,
+};
+
+// End the current job: count a miss if it finished after its deadline,
+// then sleep until the next release. A job that overran its period is
+// released again right away instead of piling up behind.
+void thread_wait_period(void) {
+    thread_t *thread = process_current_thread();
+    edf_state_t *edf = &thread->edf;
+    if (edf->params.runtime_ms == 0) {
+        thread_yield();
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    uint32_t now = scheduler_get_ticks();
+    edf->jobs++;
+    if (tick_before(edf->job_deadline, now)) {
+        uint32_t lateness = now - edf->job_deadline;
+        edf->misses++;
+        if (lateness > edf->max_lateness) {
+            edf->max_lateness = lateness;
+        }
+    }
+    
+    edf->release += timer_ms_to_ticks(edf->params.period_ms);
+    if (tick_before(edf->release, now)) {
+        edf->release = now;
+    }
+    edf->job_deadline = edf->release + timer_ms_to_ticks(edf->params.deadline_ms);
+    edf->deadline = edf->job_deadline;
+    edf->budget_ns = (int64_t)edf->params.runtime_ms * 1000000;
+    
+    while (thread_block_timeout(edf->release, NULL)) {
+        // Woken before the release: sleep out the rest
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,114 @@
+#include "process.h"
+#include "clock.h"
+#include "rbtree.h"
+
+// Weight per priority level: 1024 at the default priority 5 and about
+// 25% more CPU per level above it (the CFS nice-level weights)
+static const uint32_t fair_weights[THREAD_PRIORITY_LEVELS] = {
+    335, 423, 526, 655, 820, 1024, 1277, 1586, 1991, 2501, 3121
+};
+
+// vruntime keeps growing, so compare through the signed difference
+static int vruntime_before(uint64_t a, uint64_t b) {
+    return (int64_t)(a - b) < 0;
+}
+
+// Timeline order: smaller vruntime first, FIFO among equals
+static int fair_less(const rb_node_t *a, const rb_node_t *b) {
+    return vruntime_before(rb_entry(a, thread_t, run_node)->vruntime,
+                           rb_entry(b, thread_t, run_node)->vruntime);
+}
+
+// Thread with the smallest vruntime, or NULL
+static thread_t *fair_first(run_queue_t *rq) {
+    rb_node_t *node = rb_first(&rq->timeline);
+    return node ? rb_entry(node, thread_t, run_node) : NULL;
+}
+
+// Move min_vruntime up to the smallest vruntime still in play
+static void fair_update_min(run_queue_t *rq, uint64_t vruntime) {
+    thread_t *first = fair_first(rq);
+    if (first && vruntime_before(first->vruntime, vruntime)) {
+        vruntime = first->vruntime;
+    }
+    if (vruntime_before(rq->min_vruntime, vruntime)) {
+        rq->min_vruntime = vruntime;
+    }
+}
+
+// New threads start at min_vruntime. Waking threads keep their
+// vruntime but lose any lead over FAIR_SLEEPER_CREDIT_NS, so a long
+// sleep buys a prompt run and not a monopoly.
+static void fair_enqueue(run_queue_t *rq, thread_t *thread, uint32_t flags) {
+    if (flags & SCHED_ENQUEUE_NEW) {
+        thread->vruntime = rq->min_vruntime;
+    } else if (flags & SCHED_ENQUEUE_WAKEUP) {
+        uint64_t floor = rq->min_vruntime - FAIR_SLEEPER_CREDIT_NS;
+        if (vruntime_before(thread->vruntime, floor)) {
+            thread->vruntime = floor;
+        }
+    }
+    
+    rb_insert(&rq->timeline, &thread->run_node, fair_less);
+    rq->count++;
+}
+
+static void fair_dequeue(run_queue_t *rq, thread_t *thread) {
+    if (!rb_linked(&thread->run_node)) {
+        return;  // Not queued
+    }
+    rb_erase(&rq->timeline, &thread->run_node);
+    rq->count--;
+}
+
+// Leftmost thread: the one furthest behind its fair share
+static thread_t *fair_pick_next(run_queue_t *rq) {
+    thread_t *thread = fair_first(rq);
+    if (thread) {
+        fair_dequeue(rq, thread);
+        fair_update_min(rq, thread->vruntime);
+    }
+    return thread;
+}
+
+// Furthest-behind thread that may migrate, rebased from the victim's
+// min_vruntime onto the thief's
+static thread_t *fair_steal(run_queue_t *from, run_queue_t *to) {
+    for (rb_node_t *node = rb_first(&from->timeline); node; node = rb_next(node)) {
+        thread_t *thread = rb_entry(node, thread_t, run_node);
+        if (!thread->pinned) {
+            fair_dequeue(from, thread);
+            thread->vruntime = thread->vruntime - from->min_vruntime + to->min_vruntime;
+            return thread;
+        }
+    }
+    return NULL;
+}
+
+// Advance vruntime by ns scaled by the thread's weight
+static void fair_charge(run_queue_t *rq, thread_t *thread, uint64_t ns) {
+    thread->vruntime += udiv64_32(ns * FAIR_WEIGHT_DEFAULT, fair_weights[thread->priority], NULL);
+    fair_update_min(rq, thread->vruntime);
+}
+
+// At a tick the running thread gives way once a queued one is behind it
+static int fair_tick_preempt(run_queue_t *rq, thread_t *current) {
+    thread_t *first = fair_first(rq);
+    return first && vruntime_before(first->vruntime, current->vruntime);
+}
+
+// A woken thread preempts right away if it is far enough behind
+static int fair_wakeup_preempt(thread_t *current, thread_t *thread) {
+    return vruntime_before(thread->vruntime + FAIR_WAKEUP_GRANULARITY_NS, current->vruntime);
+}
+
+const sched_class_t fair_sched_class = {
+    .name = "fair",
+    .enqueue = fair_enqueue,
+    .dequeue = fair_dequeue,
+    .pick_next = fair_pick_next,
+    .steal = fair_steal,
+    .charge = fair_charge,
+    .tick_preempt = fair_tick_preempt,
+    .wakeup_preempt = fair_wakeup_preempt,
+};
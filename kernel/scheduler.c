@@ -1,4 +1,6 @@
 #include "scheduler.h"
+#include "process.h"
+#include "timer.h"
 
 static task_t tasks[MAX_TASKS];
 static int task_count = 0;
@@ -59,4 +61,14 @@ uint32_t scheduler_get_ticks(void) {
 
 void scheduler_tick(void) {
     ticks++;
+    timer_tick(ticks);
+}
+
+uint32_t scheduler_schedule(uint32_t esp) {
+    scheduler_tick();
+    return process_context_switch(esp);
+}
+
+uint32_t scheduler_schedule_local(uint32_t esp) {
+    return process_context_switch(esp);
 }
@@ -22,3 +22,11 @@ task_t* scheduler_get_current_task(void);
 void pit_init(void);
 uint32_t scheduler_get_ticks(void);
 void scheduler_tick(void);
+
+// Timer interrupt entry (isr_timer): takes the saved frame of the
+// interrupted thread, returns the frame to resume
+uint32_t scheduler_schedule(uint32_t esp);
+
+// LAPIC timer entry on the other CPUs (isr_lapic_timer): preempts like
+// scheduler_schedule() without advancing the global tick count
+uint32_t scheduler_schedule_local(uint32_t esp);
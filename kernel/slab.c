@@ -0,0 +1,810 @@
+#include "slab.h"
+#include "memory.h"
+#include "page.h"
+#include "cpu.h"
+#include "smp.h"
+#include "clock.h"
+#include "process.h"
+#include "waitqueue.h"
+
+// Cache table
+static kmem_cache_t cache_table[KMEM_MAX_CACHES];
+
+// Cache the magazines themselves come from (has no magazine layer)
+static kmem_cache_t *magazine_cache = NULL;
+
+// Size caches behind kmem_alloc(): 16, 32, .. 512 bytes
+static kmem_cache_t *kmem_alloc_caches[KMEM_ALLOC_CACHES];
+static const char *kmem_alloc_names[KMEM_ALLOC_CACHES] = {
+    "kmem_alloc_16", "kmem_alloc_32", "kmem_alloc_64",
+    "kmem_alloc_128", "kmem_alloc_256", "kmem_alloc_512"
+};
+
+// Empty slabs kept per cache before they are released
+#define KMEM_MAX_EMPTY_SLABS 1
+
+// Magazines the depot keeps per list; extras go back to the slabs
+#define KMEM_DEPOT_MAX_MAGAZINES 4
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+
+// Free-list link stored inside a free object
+static inline void **obj_link(kmem_cache_t *cache, void *obj) {
+    return (void **)((uint8_t *)obj + cache->link_offset);
+}
+
+// Slab owning an object (slabs are KMEM_SLAB_SIZE aligned)
+static inline kmem_slab_t *obj_to_slab(void *obj) {
+    return (kmem_slab_t *)((uintptr_t)obj & ~(uintptr_t)(KMEM_SLAB_SIZE - 1));
+}
+
+// Offset of the first object in a slab
+static inline uint32_t slab_first_offset(kmem_cache_t *cache) {
+    return (sizeof(kmem_slab_t) + cache->align - 1) & ~(cache->align - 1);
+}
+
+// Unlink a slab from one of the cache's lists
+static void slab_list_remove(kmem_slab_t **list, kmem_slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+// Push a slab onto one of the cache's lists
+static void slab_list_push(kmem_slab_t **list, kmem_slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+// Get a new slab and thread its objects onto a free list
+static kmem_slab_t *slab_grow(kmem_cache_t *cache) {
+    // Slabs are whole page frames; the heap pool is only a fallback
+    kmem_slab_t *slab = (kmem_slab_t *)alloc_pages(0);
+    if (!slab) {
+        slab = (kmem_slab_t *)memalign(KMEM_SLAB_SIZE, KMEM_SLAB_SIZE);
+    }
+    if (!slab) {
+        return NULL;  // Out of memory
+    }
+    
+    slab->cache = cache;
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->free_list = NULL;
+    slab->inuse = 0;
+    
+    // Build the free list back to front so objects are handed out in address order
+    uint8_t *first = (uint8_t *)slab + slab_first_offset(cache);
+    for (uint32_t i = cache->objects_per_slab; i > 0; i--) {
+        void *obj = first + (i - 1) * cache->stride;
+        if (cache->ctor) {
+            cache->ctor(obj);
+        }
+        *obj_link(cache, obj) = slab->free_list;
+        slab->free_list = obj;
+    }
+    
+    cache->slab_count++;
+    return slab;
+}
+
+// Return an empty slab to wherever it came from
+static void slab_release(kmem_cache_t *cache, kmem_slab_t *slab) {
+    cache->slab_count--;
+    if (page_is_allocated(slab)) {
+        free_pages(slab, 0);
+    } else {
+        free(slab);
+    }
+}
+
+// Initialize slab allocator
+void kmem_init(void) {
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        cache_table[i].is_used = 0;
+    }
+    
+    magazine_cache = kmem_cache_create("kmem_magazine_t", sizeof(kmem_magazine_t), 0, NULL);
+    if (magazine_cache) {
+        magazine_cache->use_magazines = 0;
+    }
+    
+    for (uint32_t i = 0; i < KMEM_ALLOC_CACHES; i++) {
+        kmem_alloc_caches[i] = kmem_cache_create(kmem_alloc_names[i], 1u << (i + KMEM_ALLOC_MIN_SHIFT), 0, NULL);
+    }
+}
+
+// Create an object cache
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align, void (*ctor)(void *)) {
+    if (size == 0) {
+        return NULL;  // Invalid size
+    }
+    
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    if (align & (align - 1)) {
+        return NULL;  // Alignment must be a power of two
+    }
+    
+    // Find free cache slot
+    kmem_cache_t *cache = NULL;
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        if (!cache_table[i].is_used) {
+            cache = &cache_table[i];
+            break;
+        }
+    }
+    
+    if (!cache) {
+        return NULL;  // No free cache slots
+    }
+    
+    // Constructed objects must keep their state while free, so the
+    // free-list link goes after the object instead of inside it
+    uint32_t link_offset = ctor ? (uint32_t)size : 0;
+    uint32_t footprint = ctor ? (uint32_t)size + sizeof(void *) : (uint32_t)size;
+    if (footprint < sizeof(void *)) {
+        footprint = sizeof(void *);
+    }
+    
+    cache->object_size = size;
+    cache->align = align;
+    cache->stride = (footprint + align - 1) & ~(align - 1);
+    cache->link_offset = link_offset;
+    cache->ctor = ctor;
+    
+    uint32_t first = slab_first_offset(cache);
+    if (first + cache->stride > KMEM_SLAB_SIZE) {
+        return NULL;  // Object does not fit in a slab
+    }
+    cache->objects_per_slab = (KMEM_SLAB_SIZE - first) / cache->stride;
+    
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->slab_count = 0;
+    cache->empty_count = 0;
+    cache->active_objects = 0;
+    cache->alloc_count = 0;
+    cache->free_count = 0;
+    spin_init(&cache->lock);
+    
+    cache->use_magazines = 1;
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        cache->cpu[c].loaded = NULL;
+        cache->cpu[c].previous = NULL;
+        cache->cpu[c].allocs = 0;
+        cache->cpu[c].frees = 0;
+        cache->cpu[c].hits = 0;
+    }
+    cache->depot_full = NULL;
+    cache->depot_empty = NULL;
+    cache->depot_full_count = 0;
+    cache->depot_empty_count = 0;
+    
+    // Copy name (with bounds checking)
+    uint32_t i = 0;
+    while (name && name[i] && i < KMEM_NAME_LEN - 1) {
+        cache->name[i] = name[i];
+        i++;
+    }
+    cache->name[i] = '\0';
+    
+    cache->is_used = 1;
+    return cache;
+}
+
+// Destroy a cache and release all of its slabs
+void kmem_cache_destroy(kmem_cache_t *cache) {
+    if (!cache || !cache->is_used) {
+        return;
+    }
+    
+    kmem_cache_drain(cache);
+    
+    kmem_slab_t *lists[3] = { cache->partial, cache->full, cache->empty };
+    for (uint32_t i = 0; i < 3; i++) {
+        kmem_slab_t *slab = lists[i];
+        while (slab) {
+            kmem_slab_t *next = slab->next;
+            slab_release(cache, slab);
+            slab = next;
+        }
+    }
+    
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->is_used = 0;
+}
+
+// Allocate an object straight from the cache's slabs
+static void *slab_alloc_object(kmem_cache_t *cache) {
+    kmem_slab_t *slab = cache->partial;
+    
+    if (!slab) {
+        // Reuse an empty slab before growing the cache
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+            cache->empty_count--;
+        } else {
+            slab = slab_grow(cache);
+            if (!slab) {
+                return NULL;  // Out of memory
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+    
+    // Pop an object off the slab's free list
+    void *obj = slab->free_list;
+    slab->free_list = *obj_link(cache, obj);
+    slab->inuse++;
+    
+    if (slab->inuse == cache->objects_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+    
+    cache->active_objects++;
+    cache->alloc_count++;
+    return obj;
+}
+
+// Return an object straight to its slab
+static void slab_free_object(kmem_cache_t *cache, void *obj) {
+    kmem_slab_t *slab = obj_to_slab(obj);
+    
+    // Full slabs become partial again
+    if (slab->inuse == cache->objects_per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    
+    *obj_link(cache, obj) = slab->free_list;
+    slab->free_list = obj;
+    slab->inuse--;
+    
+    // Empty slabs are kept for reuse up to a limit, then given back
+    if (slab->inuse == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty_count < KMEM_MAX_EMPTY_SLABS) {
+            slab_list_push(&cache->empty, slab);
+            cache->empty_count++;
+        } else {
+            slab_release(cache, slab);
+        }
+    }
+    
+    cache->active_objects--;
+    cache->free_count++;
+}
+
+// Magazines come straight from the slabs of magazine_cache, whose lock
+// nests inside the lock of the cache being refilled
+static kmem_magazine_t *magazine_alloc(void) {
+    spin_lock(&magazine_cache->lock);
+    kmem_magazine_t *mag = (kmem_magazine_t *)slab_alloc_object(magazine_cache);
+    spin_unlock(&magazine_cache->lock);
+    return mag;
+}
+
+// Give a magazine's objects back to the slabs and free the magazine
+// (cache->lock held)
+static void magazine_release(kmem_cache_t *cache, kmem_magazine_t *mag) {
+    for (uint32_t i = 0; i < mag->rounds; i++) {
+        slab_free_object(cache, mag->objs[i]);
+    }
+    spin_lock(&magazine_cache->lock);
+    slab_free_object(magazine_cache, mag);
+    spin_unlock(&magazine_cache->lock);
+}
+
+// Allocate an object from a cache. The CPU's loaded magazine serves it with
+// interrupts off and no lock; the depot and slabs are the fallback, under
+// the cache lock.
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (!cache) {
+        return NULL;
+    }
+    
+    uint32_t flags = irq_save();
+    void *obj = NULL;
+    
+    if (cache->use_magazines) {
+        kmem_cpu_cache_t *cc = &cache->cpu[cpu_current_id()];
+        cc->allocs++;
+        
+        if (cc->loaded && cc->loaded->rounds > 0) {
+            obj = cc->loaded->objs[--cc->loaded->rounds];
+            cc->hits++;
+            irq_restore(flags);
+            return obj;
+        }
+    }
+    
+    // Slow path: trade magazines with the depot, then go to the slabs
+    spin_lock(&cache->lock);
+    if (cache->use_magazines) {
+        kmem_cpu_cache_t *cc = &cache->cpu[cpu_current_id()];
+        
+        while (1) {
+            if (cc->loaded && cc->loaded->rounds > 0) {
+                obj = cc->loaded->objs[--cc->loaded->rounds];
+                cc->hits++;
+                break;
+            }
+            
+            // The spare is always either full or empty
+            if (cc->previous && cc->previous->rounds > 0) {
+                kmem_magazine_t *tmp = cc->loaded;
+                cc->loaded = cc->previous;
+                cc->previous = tmp;
+                continue;
+            }
+            
+            // Trade the empty spare for a full magazine from the depot
+            if (cache->depot_full) {
+                if (cc->previous && cache->depot_empty_count < KMEM_DEPOT_MAX_MAGAZINES) {
+                    cc->previous->next = cache->depot_empty;
+                    cache->depot_empty = cc->previous;
+                    cache->depot_empty_count++;
+                } else if (cc->previous) {
+                    magazine_release(cache, cc->previous);
+                }
+                cc->previous = cc->loaded;
+                cc->loaded = cache->depot_full;
+                cache->depot_full = cc->loaded->next;
+                cache->depot_full_count--;
+                continue;
+            }
+            
+            break;
+        }
+    }
+    
+    if (!obj) {
+        obj = slab_alloc_object(cache);
+    }
+    spin_unlock(&cache->lock);
+    irq_restore(flags);
+    return obj;
+}
+
+// Return an object to its cache, through the CPU's magazines when possible
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (!cache || !obj) {
+        return;
+    }
+    
+    if (obj_to_slab(obj)->cache != cache) {
+        return;  // Object does not belong to this cache
+    }
+    
+    uint32_t flags = irq_save();
+    
+    if (cache->use_magazines) {
+        kmem_cpu_cache_t *cc = &cache->cpu[cpu_current_id()];
+        cc->frees++;
+        
+        if (cc->loaded && cc->loaded->rounds < KMEM_MAGAZINE_SIZE) {
+            cc->loaded->objs[cc->loaded->rounds++] = obj;
+            cc->hits++;
+            irq_restore(flags);
+            return;
+        }
+    }
+    
+    spin_lock(&cache->lock);
+    if (cache->use_magazines) {
+        kmem_cpu_cache_t *cc = &cache->cpu[cpu_current_id()];
+        
+        while (1) {
+            if (cc->loaded && cc->loaded->rounds < KMEM_MAGAZINE_SIZE) {
+                cc->loaded->objs[cc->loaded->rounds++] = obj;
+                cc->hits++;
+                obj = NULL;
+                break;
+            }
+            
+            if (cc->previous && cc->previous->rounds == 0) {
+                kmem_magazine_t *tmp = cc->loaded;
+                cc->loaded = cc->previous;
+                cc->previous = tmp;
+                continue;
+            }
+            
+            // Trade the full spare for an empty magazine from the depot
+            if (cache->depot_empty) {
+                if (cc->previous && cache->depot_full_count < KMEM_DEPOT_MAX_MAGAZINES) {
+                    cc->previous->next = cache->depot_full;
+                    cache->depot_full = cc->previous;
+                    cache->depot_full_count++;
+                } else if (cc->previous) {
+                    magazine_release(cache, cc->previous);
+                }
+                cc->previous = cc->loaded;
+                cc->loaded = cache->depot_empty;
+                cache->depot_empty = cc->loaded->next;
+                cache->depot_empty_count--;
+                continue;
+            }
+            
+            // Grow the depot by one empty magazine
+            kmem_magazine_t *mag = magazine_alloc();
+            if (!mag) {
+                break;
+            }
+            mag->rounds = 0;
+            mag->next = cache->depot_empty;
+            cache->depot_empty = mag;
+            cache->depot_empty_count++;
+        }
+    }
+    
+    if (obj) {
+        slab_free_object(cache, obj);
+    }
+    spin_unlock(&cache->lock);
+    irq_restore(flags);
+}
+
+// Return every magazine-held object to the slabs. Only safe while no
+// other CPU is using the cache.
+void kmem_cache_drain(kmem_cache_t *cache) {
+    if (!cache || !cache->use_magazines) {
+        return;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    
+    for (uint32_t c = 0; c < MAX_CPUS; c++) {
+        kmem_cpu_cache_t *cc = &cache->cpu[c];
+        if (cc->loaded) {
+            magazine_release(cache, cc->loaded);
+            cc->loaded = NULL;
+        }
+        if (cc->previous) {
+            magazine_release(cache, cc->previous);
+            cc->previous = NULL;
+        }
+    }
+    
+    kmem_magazine_t *lists[2] = { cache->depot_full, cache->depot_empty };
+    for (uint32_t i = 0; i < 2; i++) {
+        kmem_magazine_t *mag = lists[i];
+        while (mag) {
+            kmem_magazine_t *next = mag->next;
+            magazine_release(cache, mag);
+            mag = next;
+        }
+    }
+    cache->depot_full = NULL;
+    cache->depot_empty = NULL;
+    cache->depot_full_count = 0;
+    cache->depot_empty_count = 0;
+    
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+// Size cache serving a kmem_alloc() request, or NULL for large sizes
+static kmem_cache_t *kmem_alloc_cache(size_t size) {
+    uint32_t index = 0;
+    while (index < KMEM_ALLOC_CACHES && (1u << (index + KMEM_ALLOC_MIN_SHIFT)) < size) {
+        index++;
+    }
+    return (index < KMEM_ALLOC_CACHES) ? kmem_alloc_caches[index] : NULL;
+}
+
+// Allocate from the magazine-backed size caches
+void *kmem_alloc(size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+    
+    kmem_cache_t *cache = kmem_alloc_cache(size);
+    return cache ? kmem_cache_alloc(cache) : malloc(size);
+}
+
+// Free a kmem_alloc() buffer; size must be the size it was allocated with
+void kmem_free(void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    
+    kmem_cache_t *cache = kmem_alloc_cache(size);
+    if (cache) {
+        kmem_cache_free(cache, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+// Print slab cache statistics
+void kmem_print_stats(void) {
+    char buffer[64];
+    
+    console_puts("\n=== Slab Caches ===\n");
+    
+    for (uint32_t i = 0; i < KMEM_MAX_CACHES; i++) {
+        kmem_cache_t *cache = &cache_table[i];
+        if (!cache->is_used) {
+            continue;
+        }
+        
+        // Objects parked in magazines are free, just not back in a slab
+        uint32_t allocs = cache->alloc_count;
+        uint32_t frees = cache->free_count;
+        uint32_t hits = 0;
+        uint32_t cached = cache->depot_full_count * KMEM_MAGAZINE_SIZE;
+        if (cache->use_magazines) {
+            allocs = 0;
+            frees = 0;
+            for (uint32_t c = 0; c < MAX_CPUS; c++) {
+                kmem_cpu_cache_t *cc = &cache->cpu[c];
+                allocs += cc->allocs;
+                frees += cc->frees;
+                hits += cc->hits;
+                cached += cc->loaded ? cc->loaded->rounds : 0;
+                cached += cc->previous ? cc->previous->rounds : 0;
+            }
+        }
+        
+        console_puts(cache->name);
+        console_puts(" | Obj: ");
+        itoa(cache->object_size, buffer);
+        console_puts(buffer);
+        console_puts("B | Active: ");
+        itoa(cache->active_objects - cached, buffer);
+        console_puts(buffer);
+        console_puts("/");
+        itoa(cache->slab_count * cache->objects_per_slab, buffer);
+        console_puts(buffer);
+        console_puts(" | Slabs: ");
+        itoa(cache->slab_count, buffer);
+        console_puts(buffer);
+        console_puts(" | Allocs: ");
+        itoa(allocs, buffer);
+        console_puts(buffer);
+        console_puts(" | Frees: ");
+        itoa(frees, buffer);
+        console_puts(buffer);
+        uint32_t total = allocs + frees;
+        if (cache->use_magazines && total > 0) {
+            // Scale down first when hits * 100 could overflow
+            uint32_t percent = (total < 0x1000000) ? hits * 100 / total : hits / (total / 100);
+            console_puts(" | Mag Hits: ");
+            itoa(percent, buffer);
+            console_puts(buffer);
+            console_puts("% | Cached: ");
+            itoa(cached, buffer);
+            console_puts(buffer);
+        }
+        console_puts("\n");
+    }
+}
+
+// Benchmark variants: magazine layer, bare slab layer, malloc heap
+static void *bench_alloc_magazine(kmem_cache_t *cache) {
+    return kmem_cache_alloc(cache);
+}
+
+static void bench_free_magazine(kmem_cache_t *cache, void *obj) {
+    kmem_cache_free(cache, obj);
+}
+
+static void *bench_alloc_slab(kmem_cache_t *cache) {
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    void *obj = slab_alloc_object(cache);
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return obj;
+}
+
+static void bench_free_slab(kmem_cache_t *cache, void *obj) {
+    uint32_t flags = spin_lock_irqsave(&cache->lock);
+    slab_free_object(cache, obj);
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+static void *bench_alloc_heap(kmem_cache_t *cache) {
+    return malloc(cache->object_size);
+}
+
+static void bench_free_heap(kmem_cache_t *cache, void *obj) {
+    (void)cache;
+    free(obj);
+}
+
+// One worker's kmem_benchmark() run
+typedef struct {
+    uint32_t ops;                      // Allocations and frees that succeeded
+    uint32_t failed;                   // Allocations that did not
+    uint64_t ns;                       // Timed rounds, from its own start
+    uint64_t end;                      // clock_monotonic_ns() when done
+} kmem_bench_result_t;
+
+static void *(*const bench_allocs[3])(kmem_cache_t *) = {
+    bench_alloc_magazine, bench_alloc_slab, bench_alloc_heap
+};
+static void (*const bench_frees[3])(kmem_cache_t *, void *) = {
+    bench_free_magazine, bench_free_slab, bench_free_heap
+};
+
+// The run in progress: cache and variant under test, the start flag the
+// workers wait on, and how many of them finished; the shell waits on
+// bench_wait
+static kmem_cache_t *bench_cache = NULL;
+static volatile uint32_t bench_variant = 0;
+static volatile uint32_t bench_go = 0;
+static volatile uint32_t bench_done = 0;
+static wait_queue_t bench_wait;
+static kmem_bench_result_t bench_results[MAX_CPUS];
+
+// Main thread of the benchmark process: the workers are pinned threads
+// of their own
+static void bench_idle(void) {
+}
+
+// kmem_benchmark() worker, pinned to one CPU: a warm-up round, then wait
+// for the start and time the rounds
+static void bench_worker(void) {
+    void *objs[KMEM_BENCH_BATCH];
+    kmem_bench_result_t *result = &bench_results[cpu_current_id()];
+    void *(*alloc)(kmem_cache_t *) = bench_allocs[bench_variant];
+    void (*release)(kmem_cache_t *, void *) = bench_frees[bench_variant];
+    uint32_t ops = 0;
+    uint32_t failed = 0;
+    
+    for (uint32_t r = 0; r <= KMEM_BENCH_ROUNDS; r++) {
+        if (r == 1) {
+            while (!__atomic_load_n(&bench_go, __ATOMIC_ACQUIRE)) {
+                thread_yield();
+            }
+            result->ns = clock_monotonic_ns();
+            ops = 0;
+            failed = 0;
+        }
+        for (uint32_t i = 0; i < KMEM_BENCH_BATCH; i++) {
+            objs[i] = alloc(bench_cache);
+            failed += objs[i] ? 0 : 1;
+        }
+        for (uint32_t i = 0; i < KMEM_BENCH_BATCH; i++) {
+            if (objs[i]) {
+                release(bench_cache, objs[i]);
+                ops += 2;
+            }
+        }
+    }
+    
+    result->end = clock_monotonic_ns();
+    result->ns = result->end - result->ns;
+    result->ops = ops;
+    result->failed = failed;
+    
+    __atomic_fetch_add(&bench_done, 1, __ATOMIC_RELEASE);
+    wake_all(&bench_wait);
+}
+
+// Operations per second from a count and nanoseconds
+static uint32_t bench_rate(uint32_t ops, uint64_t ns) {
+    uint32_t us = (uint32_t)udiv64_32(ns, 1000, NULL);
+    return (uint32_t)udiv64_32((uint64_t)ops * 1000000, us ? us : 1, NULL);
+}
+
+// Run one variant with a worker pinned to each online CPU, all released
+// at once; returns the wall time in nanoseconds until the last finished,
+// or 0 if the workers could not be created
+static uint64_t bench_run(uint32_t variant) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        bench_results[i].ops = 0;
+        bench_results[i].failed = 0;
+    }
+    bench_variant = variant;
+    bench_go = 0;
+    bench_done = 0;
+    
+    uint32_t pid = process_create(bench_idle, PAGE_SIZE, "kmembench");
+    if (!pid) {
+        return 0;
+    }
+    
+    uint32_t started = 0;
+    uint32_t wanted = 0;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (smp_get_cpu(i)->online) {
+            wanted++;
+            started += thread_create_on(pid, bench_worker, 5, i) ? 1 : 0;
+        }
+    }
+    
+    uint64_t start = clock_monotonic_ns();
+    __atomic_store_n(&bench_go, 1, __ATOMIC_RELEASE);
+    wait_event(&bench_wait, bench_done >= started);
+    process_terminate(pid);
+    
+    if (started < wanted) {
+        return 0;
+    }
+    
+    uint64_t end = start;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (bench_results[i].ops && bench_results[i].end > end) {
+            end = bench_results[i].end;
+        }
+    }
+    return end - start;
+}
+
+// Batches of alloc/free pairs through each layer from every online CPU
+// at once: total ops/sec, then each CPU's own
+void kmem_benchmark(void) {
+    static const char *names[3] = { "magazines:  ", "slabs only: ", "malloc:     " };
+    char buffer[16];
+    
+    bench_cache = kmem_alloc_caches[2];  // 64-byte objects
+    if (!bench_cache) {
+        console_puts("Error: kmem_alloc caches not initialized\n");
+        return;
+    }
+    wait_queue_init(&bench_wait);
+    
+    console_puts("\n=== Slab Stress Benchmark (64B objects, alloc/free batches of 32, ");
+    itoa(smp_cpu_count(), buffer);
+    console_puts(buffer);
+    console_puts(" CPU(s)) ===\n");
+    
+    for (uint32_t v = 0; v < 3; v++) {
+        uint64_t elapsed = bench_run(v);
+        if (!elapsed) {
+            console_puts("Error: Could not create benchmark threads\n");
+            return;
+        }
+        
+        uint32_t total = 0;
+        uint32_t failed = 0;
+        for (uint32_t i = 0; i < MAX_CPUS; i++) {
+            total += bench_results[i].ops;
+            failed += bench_results[i].failed;
+        }
+        
+        console_puts(names[v]);
+        itoa(bench_rate(total, elapsed), buffer);
+        console_puts(buffer);
+        console_puts(" ops/s");
+        for (uint32_t i = 0; i < MAX_CPUS; i++) {
+            if (!smp_get_cpu(i)->online) {
+                continue;
+            }
+            console_puts(" | CPU ");
+            itoa(i, buffer);
+            console_puts(buffer);
+            console_puts(": ");
+            itoa(bench_rate(bench_results[i].ops, bench_results[i].ns), buffer);
+            console_puts(buffer);
+        }
+        if (failed) {
+            console_puts(" (alloc failures)");
+        }
+        console_puts("\n");
+        
+        // Start the slab-only run without objects parked in magazines
+        if (v == 0) {
+            kmem_cache_drain(bench_cache);
+        }
+    }
+}
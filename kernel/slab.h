@@ -0,0 +1,95 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+#include "spinlock.h"
+
+// Slab cache constants
+#define KMEM_MAX_CACHES 16
+#define KMEM_SLAB_SIZE 4096         // Each slab is one page frame
+#define KMEM_NAME_LEN 24
+#define KMEM_MAGAZINE_SIZE 15       // Objects per magazine
+#define KMEM_ALLOC_MIN_SHIFT 4      // kmem_alloc() size caches: 16 bytes ..
+#define KMEM_ALLOC_CACHES 6         // .. 512 bytes; larger sizes use malloc()
+#define KMEM_BENCH_BATCH 32         // kmem_benchmark(): objects held per round ..
+#define KMEM_BENCH_ROUNDS 2000      // .. and timed rounds per worker
+
+// Magazine: a small stack of free objects owned by one CPU or the depot
+typedef struct kmem_magazine {
+    struct kmem_magazine *next;     // Next magazine in a depot list
+    uint32_t rounds;                // Objects currently held
+    void *objs[KMEM_MAGAZINE_SIZE]; // Object stack
+} kmem_magazine_t;
+
+// Per-CPU magazine pair; only ever touched by its own CPU, and aligned
+// so that no two CPUs' counters share a cache line
+typedef struct {
+    kmem_magazine_t *loaded;        // Magazine allocations and frees hit first
+    kmem_magazine_t *previous;      // Full or empty spare, swapped with loaded
+    uint32_t allocs;                // Allocations made on this CPU
+    uint32_t frees;                 // Frees made on this CPU
+    uint32_t hits;                  // Allocs/frees served by the loaded magazine
+} __attribute__((aligned(CACHE_LINE_SIZE))) kmem_cpu_cache_t;
+
+// Slab: a KMEM_SLAB_SIZE chunk carved into equal-sized objects
+typedef struct kmem_slab {
+    struct kmem_cache *cache;       // Owning cache
+    struct kmem_slab *next;         // Next slab in the cache's list
+    struct kmem_slab *prev;         // Previous slab in the cache's list
+    void *free_list;                // Free objects in this slab
+    uint32_t inuse;                 // Allocated objects in this slab
+} kmem_slab_t;
+
+// Object cache for fixed-size kernel objects
+typedef struct kmem_cache {
+    char name[KMEM_NAME_LEN];       // Cache name (for statistics)
+    uint32_t object_size;           // Requested object size
+    uint32_t stride;                // Distance between objects in a slab
+    uint32_t align;                 // Object alignment
+    uint32_t link_offset;           // Offset of the free-list link in an object
+    uint32_t objects_per_slab;      // Objects that fit in one slab
+    void (*ctor)(void *);           // Optional constructor, run once per object
+    kmem_slab_t *partial;           // Slabs with free and used objects
+    kmem_slab_t *full;              // Slabs with no free objects
+    kmem_slab_t *empty;             // Slabs with no used objects
+    uint32_t slab_count;            // Slabs owned by this cache
+    uint32_t empty_count;           // Slabs on the empty list
+    uint32_t active_objects;        // Objects out of the slabs (in use or in magazines)
+    uint32_t alloc_count;           // Objects taken from the slabs
+    uint32_t free_count;            // Objects returned to the slabs
+    uint8_t use_magazines;          // 1 if objects go through per-CPU magazines
+    spinlock_t lock;                // Guards the slab lists and the depot
+    kmem_magazine_t *depot_full;    // Depot of full magazines shared by all CPUs
+    kmem_magazine_t *depot_empty;   // Depot of empty magazines
+    uint32_t depot_full_count;      // Magazines on depot_full
+    uint32_t depot_empty_count;     // Magazines on depot_empty
+    uint8_t is_used;                // 1 if cache slot is in use
+    kmem_cpu_cache_t cpu[MAX_CPUS]; // Per-CPU magazine layer, clear of the lines above
+} kmem_cache_t;
+
+// Initialize slab allocator
+void kmem_init(void);
+
+// Cache operations
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align, void (*ctor)(void *));
+void kmem_cache_destroy(kmem_cache_t *cache);
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+// Return every magazine-held object to the slabs
+void kmem_cache_drain(kmem_cache_t *cache);
+
+// Sized allocations through magazine-backed caches (size must match on free)
+void *kmem_alloc(size_t size);
+void kmem_free(void *ptr, size_t size);
+
+// Statistics
+void kmem_print_stats(void);
+
+// Alloc/free stress benchmark for the magazine layer, one worker per
+// online CPU
+void kmem_benchmark(void);
+
+#endif // SLAB_H
@@ -0,0 +1,314 @@
+#include "smp.h"
+#include "apic.h"
+#include "clock.h"
+#include "idt.h"
+#include "memops.h"
+#include "page.h"
+#include "paging.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "waitqueue.h"
+
+// Per-CPU blocks, indexed by cpu_t.id
+static cpu_t cpus[MAX_CPUS];
+static volatile uint32_t cpus_online = 1;
+
+// GDT shared by every CPU: boot.asm's flat segments plus one GS segment
+// per CPU covering just its cpu_t
+static uint64_t gdt[SMP_GDT_ENTRIES] __attribute__((aligned(8)));
+static struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr;
+
+// CPU the trampoline is bringing up (APs start one at a time)
+static cpu_t *volatile ap_booting = NULL;
+
+// TLB shootdown in progress: one at a time, counting down the acks
+static spinlock_t tlb_lock = SPINLOCK_INIT;
+static volatile uint32_t tlb_pending = 0;
+
+// smp_benchmark() workers finished so far, and where the shell waits
+static volatile uint32_t bench_done = 0;
+static wait_queue_t bench_wait;
+
+// AP entry code (trampoline.asm), copied to SMP_TRAMPOLINE_BASE; the
+// parameter block holds CR3, the stack top and the 32-bit entry point
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_params[];
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+
+// Encode a GDT descriptor
+static uint64_t gdt_descriptor(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    return (uint64_t)(limit & 0xFFFF) |
+           ((uint64_t)(base & 0xFFFFFF) << 16) |
+           ((uint64_t)access << 40) |
+           ((uint64_t)((limit >> 16) & 0xF) << 48) |
+           ((uint64_t)(flags & 0xF) << 52) |
+           ((uint64_t)(base >> 24) << 56);
+}
+
+// Load the shared GDT, reload every segment register and point GS at
+// CPU id's block
+static void smp_load_segments(uint32_t id) {
+    asm volatile("lgdt %0" : : "m"(gdt_ptr));
+    asm volatile("ljmp %0, $1f\n"
+                 "1:\n\t"
+                 "mov %1, %%ds\n\t"
+                 "mov %1, %%es\n\t"
+                 "mov %1, %%fs\n\t"
+                 "mov %1, %%ss\n\t"
+                 "mov %2, %%gs"
+                 : : "i"(KERNEL_CODE_SELECTOR), "r"(KERNEL_DATA_SELECTOR), "r"(SMP_CPU_SELECTOR(id))
+                 : "memory");
+}
+
+// Build the GDT and switch the boot CPU to it
+void smp_init(void) {
+    gdt[0] = 0;
+    gdt[1] = 0x00cf9a000000ffffULL;    // Code segment (0x08)
+    gdt[2] = 0x00cf92000000ffffULL;    // Data segment (0x10)
+    
+    // Byte-granular 32-bit data segments based at each cpu_t
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        cpus[i].self = &cpus[i];
+        cpus[i].id = i;
+        cpus[i].online = 0;
+        gdt[3 + i] = gdt_descriptor((uint32_t)&cpus[i], sizeof(cpu_t) - 1, 0x92, 0x4);
+    }
+    
+    gdt_ptr.limit = sizeof(gdt) - 1;
+    gdt_ptr.base = (uint32_t)gdt;
+    smp_load_segments(0);
+    
+    cpus[0].online = 1;
+    cpus_online = 1;
+}
+
+// First C code on an application processor, on its idle thread's stack
+static void ap_main(void) {
+    cpu_t *cpu = ap_booting;
+    
+    smp_load_segments(cpu->id);
+    idt_load();
+    memops_init();
+    lapic_init();
+    cpu->online = 1;
+    
+    lapic_timer_start(TIMER_HZ);
+    process_cpu_start();
+}
+
+// Start the application processors one by one: INIT, then up to two
+// startup IPIs pointing at the trampoline page
+uint32_t smp_boot_aps(void) {
+    char buffer[16];
+    
+    if (!apic_enabled()) {
+        return cpus_online;  // No APICs
+    }
+    
+    cpus[0].apic_id = lapic_id();
+    if (clock_tsc_khz() == 0) {
+        return cpus_online;  // No clock for the IPI delays
+    }
+    
+    memcpy((void *)SMP_TRAMPOLINE_BASE, ap_trampoline_start, ap_trampoline_end - ap_trampoline_start);
+    uint32_t *params = (uint32_t *)(SMP_TRAMPOLINE_BASE + (ap_trampoline_params - ap_trampoline_start));
+    
+    uint32_t next = 1;
+    for (uint32_t i = 0; i < apic_cpu_count() && next < MAX_CPUS; i++) {
+        uint32_t apic_id = apic_cpu_apic_id(i);
+        if (apic_id == cpus[0].apic_id) {
+            continue;  // That's us
+        }
+        
+        cpu_t *cpu = &cpus[next];
+        cpu->apic_id = apic_id;
+        params[0] = paging_kernel_cr3();
+        params[1] = (uint32_t)(cpu->idle->stack + cpu->idle->stack_size);
+        params[2] = (uint32_t)ap_main;
+        ap_booting = cpu;
+        
+        lapic_send_init(apic_id);
+        lapic_send_startup(apic_id, SMP_TRAMPOLINE_BASE >> 12);
+        if (!cpu->online) {
+            lapic_send_startup(apic_id, SMP_TRAMPOLINE_BASE >> 12);
+        }
+        
+        uint64_t deadline = clock_monotonic_ns() + (uint64_t)SMP_AP_TIMEOUT_MS * 1000000;
+        while (!cpu->online && clock_monotonic_ns() < deadline) {
+            cpu_relax();
+        }
+        
+        if (cpu->online) {
+            next++;
+            cpus_online++;
+        } else {
+            console_puts("SMP: CPU with APIC ID ");
+            itoa(apic_id, buffer);
+            console_puts(buffer);
+            console_puts(" did not start\n");
+        }
+    }
+    
+    console_puts("SMP: ");
+    itoa(cpus_online, buffer);
+    console_puts(buffer);
+    console_puts(" CPU(s) online\n");
+    return cpus_online;
+}
+
+// CPUs online
+uint32_t smp_cpu_count(void) {
+    return cpus_online;
+}
+
+// Block of CPU index id
+cpu_t *smp_get_cpu(uint32_t id) {
+    return (id < MAX_CPUS) ? &cpus[id] : NULL;
+}
+
+// Ask a CPU to reschedule now. Sent to this CPU, the IPI is taken as
+// soon as interrupts are back on.
+void smp_send_reschedule(uint32_t id) {
+    if (id < MAX_CPUS && cpus[id].online && apic_enabled()) {
+        lapic_send_ipi(cpus[id].apic_id, RESCHED_VECTOR);
+    }
+}
+
+// Flush the TLB everywhere. The lock is taken and the acks awaited with
+// interrupts on, so two CPUs shooting at each other both get answered.
+void smp_tlb_shootdown(void) {
+    if (cpus_online < 2) {
+        write_cr3(read_cr3());
+        return;
+    }
+    
+    while (!spin_trylock(&tlb_lock)) {
+        cpu_relax();
+    }
+    
+    uint32_t flags = irq_save();
+    uint32_t self = cpu_current_id();
+    uint32_t targets = 0;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (i != self && cpus[i].online) {
+            targets++;
+        }
+    }
+    
+    tlb_pending = targets;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (i != self && cpus[i].online) {
+            lapic_send_ipi(cpus[i].apic_id, TLB_VECTOR);
+        }
+    }
+    write_cr3(read_cr3());
+    irq_restore(flags);
+    
+    while (tlb_pending) {
+        cpu_relax();
+    }
+    spin_unlock(&tlb_lock);
+}
+
+// TLB shootdown IPI: reloading CR3 drops every non-global translation
+void smp_tlb_handler(void) {
+    write_cr3(read_cr3());
+    __atomic_fetch_sub(&tlb_pending, 1, __ATOMIC_RELEASE);
+    irq_eoi();
+}
+
+// smp_benchmark() worker: a fixed amount of work, then report in
+static void bench_worker(void) {
+    volatile uint32_t sink = 0;
+    for (uint32_t i = 0; i < SMP_BENCH_ITERATIONS; i++) {
+        sink += i;
+    }
+    
+    __atomic_fetch_add(&bench_done, 1, __ATOMIC_RELEASE);
+    wake_all(&bench_wait);
+}
+
+// Run workers bench_worker() threads in one process; returns the wall
+// time in microseconds, or 0 if they could not be created
+static uint32_t bench_run(uint32_t workers) {
+    bench_done = 0;
+    uint64_t start = clock_monotonic_ns();
+    
+    uint32_t pid = process_create(bench_worker, PAGE_SIZE, "smpbench");
+    if (!pid) {
+        return 0;
+    }
+    
+    uint32_t started = 1;
+    while (started < workers && thread_create(pid, bench_worker, 5)) {
+        started++;
+    }
+    
+    wait_event(&bench_wait, bench_done >= started);
+    uint64_t elapsed = clock_monotonic_ns() - start;
+    process_terminate(pid);
+    
+    if (started < workers) {
+        return 0;
+    }
+    return (uint32_t)udiv64_32(elapsed, 1000, NULL);
+}
+
+// Print a time in microseconds as milliseconds
+static void bench_print_ms(uint32_t us) {
+    char buffer[16];
+    
+    itoa(us / 1000, buffer);
+    console_puts(buffer);
+    console_puts(" ms");
+}
+
+// Same work per worker in both runs, so with perfect scaling W workers
+// take as long as one
+void smp_benchmark(void) {
+    char buffer[16];
+    uint32_t workers = cpus_online < MAX_THREADS_PER_PROCESS ? cpus_online : MAX_THREADS_PER_PROCESS;
+    
+    wait_queue_init(&bench_wait);
+    console_puts("\n=== SMP Benchmark ===\n");
+    
+    uint32_t one = bench_run(1);
+    uint32_t many = one ? bench_run(workers) : 0;
+    if (!one || !many) {
+        console_puts("Error: Could not create benchmark threads\n");
+        return;
+    }
+    
+    console_puts("1 worker:  ");
+    bench_print_ms(one);
+    console_puts("\n");
+    
+    itoa(workers, buffer);
+    console_puts(buffer);
+    console_puts(" worker(s) on ");
+    itoa(cpus_online, buffer);
+    console_puts(buffer);
+    console_puts(" CPU(s): ");
+    bench_print_ms(many);
+    console_puts("\n");
+    
+    // workers * one / many, to two decimals
+    uint32_t speedup = (uint32_t)udiv64_32((uint64_t)workers * one * 100, many, NULL);
+    console_puts("Speedup: ");
+    itoa(speedup / 100, buffer);
+    console_puts(buffer);
+    console_puts(".");
+    if (speedup % 100 < 10) {
+        console_puts("0");
+    }
+    itoa(speedup % 100, buffer);
+    console_puts(buffer);
+    console_puts("x\n");
+}
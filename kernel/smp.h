@@ -0,0 +1,67 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "process.h"
+
+// Real-mode page the AP trampoline is copied to (reserved by page.c)
+#define SMP_TRAMPOLINE_BASE 0x8000
+#define SMP_AP_TIMEOUT_MS 100          // Wait for an AP to come online
+#define SMP_GDT_ENTRIES (3 + MAX_CPUS) // null, code, data, one GS segment per CPU
+#define SMP_CPU_SELECTOR(id) ((3 + (id)) * 8)
+#define SMP_BENCH_ITERATIONS 20000000  // Busy-loop iterations per smp_benchmark() worker
+
+// Per-CPU block. GS holds a segment based at the executing CPU's block,
+// so self and id are reachable as gs:0 and gs:4 without knowing which CPU
+// this is; keep both first.
+typedef struct cpu {
+    struct cpu *self;                  // gs:0, for this_cpu()
+    uint32_t id;                       // gs:4, index into the CPU table (cpu_current_id())
+    uint32_t apic_id;                  // Local APIC ID
+    volatile uint32_t online;          // Set once the CPU schedules threads
+    thread_t *current;                 // Thread running here
+    thread_t *idle;                    // This CPU's idle thread
+    thread_t *prev;                    // Thread just switched away from, until process_finish_switch()
+    address_space_t *space;            // Address space in CR3 (NULL = kernel directory)
+    run_queue_t run_queue;             // Threads waiting for this CPU
+    uint32_t ticks;                    // Timer ticks taken here
+    uint32_t steals;                   // Threads taken from other CPUs' run queues
+    uint32_t rt_bandwidth;             // EDF density admitted here, parts per million
+    uint32_t wait_hist[SCHED_LAT_BUCKETS];  // Run-queue wait of threads started here (process.h buckets)
+} cpu_t;
+
+// Per-CPU block of the executing CPU
+static inline cpu_t *this_cpu(void) {
+    cpu_t *cpu;
+    asm volatile("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// Install the GDT with the per-CPU segments and point GS at the boot
+// CPU's block; must run before anything touches per-CPU state
+void smp_init(void);
+
+// Start every other CPU in the MADT through the trampoline (needs the
+// APICs and a TSC clock); returns the number of CPUs online
+uint32_t smp_boot_aps(void);
+
+// CPUs online, and the block of CPU index id (any id < MAX_CPUS)
+uint32_t smp_cpu_count(void);
+cpu_t *smp_get_cpu(uint32_t id);
+
+// Ask a CPU, possibly this one, to reschedule now (RESCHED_VECTOR)
+void smp_send_reschedule(uint32_t id);
+
+// Flush the TLB on every online CPU and wait until all have; call with
+// interrupts on and no spinlock held
+void smp_tlb_shootdown(void);
+
+// TLB_VECTOR handler (isr_tlb)
+void smp_tlb_handler(void);
+
+// Time one worker, then one worker per CPU doing the same work each,
+// and print the speedup
+void smp_benchmark(void);
+
+#endif // SMP_H
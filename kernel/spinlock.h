@@ -0,0 +1,53 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// Ticket lock: a CPU takes the next ticket and spins until the owner
+// count reaches it, so waiters get the lock in arrival order
+typedef struct {
+    volatile uint16_t next;         // Next ticket to hand out
+    volatile uint16_t owner;        // Ticket currently holding the lock
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0, 0 }
+
+static inline void spin_init(spinlock_t *lock) {
+    lock->next = 0;
+    lock->owner = 0;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        cpu_relax();
+    }
+}
+
+// Take the lock only if nobody holds or waits for it; returns 1 on success
+static inline int spin_trylock(spinlock_t *lock) {
+    uint16_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+    uint16_t expected = owner;
+    return __atomic_compare_exchange_n(&lock->next, &expected, (uint16_t)(owner + 1), 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+}
+
+// Interrupts off, then the lock; an interrupt handler on this CPU that
+// wants the same lock would otherwise spin forever
+static inline uint32_t spin_lock_irqsave(spinlock_t *lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif // SPINLOCK_H
@@ -0,0 +1,313 @@
+#include "timer.h"
+#include "scheduler.h"
+#include "memory.h"
+#include "cpu.h"
+#include "spinlock.h"
+
+// Wheel slots, level-major: slot n covers ticks with the same bits above
+// level n's range. Each slot is an unordered doubly linked list.
+static timer_t *wheel[TIMER_LEVELS * TIMER_SLOTS];
+
+// Next tick timer_tick() has to process
+static uint32_t timer_jiffies = 0;
+
+// Timer statistics
+static timer_stats_t timer_stats = {0};
+
+// Guards the wheel; timer_tick() drops it around each callback
+static spinlock_t timer_lock = SPINLOCK_INIT;
+
+// Timer whose callback timer_tick() is running (NULL between callbacks)
+static timer_t *volatile timer_running = NULL;
+
+// External function declarations
+void console_puts(const char *s);
+void itoa(int num, char *str);
+
+// Queue a timer in the slot for its deadline, relative to timer_jiffies
+static void wheel_insert(timer_t *timer) {
+    uint32_t delta = timer->expires - timer_jiffies;
+    uint32_t slot;
+    
+    if ((int32_t)delta < 0) {
+        // Already due: the slot processed next
+        slot = timer_jiffies & TIMER_SLOT_MASK;
+    } else {
+        if (delta > TIMER_MAX_DELTA) {
+            delta = TIMER_MAX_DELTA;
+            timer->expires = timer_jiffies + delta;
+        }
+        
+        // Lowest level whose range covers the delta
+        uint32_t level = 0;
+        while (delta >= (1u << (TIMER_SLOT_BITS * (level + 1)))) {
+            level++;
+        }
+        slot = level * TIMER_SLOTS + ((timer->expires >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK);
+    }
+    
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = wheel[slot];
+    if (wheel[slot]) {
+        wheel[slot]->prev = timer;
+    }
+    wheel[slot] = timer;
+    timer->pending = 1;
+}
+
+// Unlink a pending timer from its slot
+static void wheel_remove(timer_t *timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel[timer->slot] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->pending = 0;
+}
+
+// Re-queue every timer of an upper-level slot; they land at least one
+// level lower since their deadlines are now within that slot's range
+static void wheel_cascade(uint32_t level, uint32_t index) {
+    timer_t *timer = wheel[level * TIMER_SLOTS + index];
+    wheel[level * TIMER_SLOTS + index] = NULL;
+    
+    while (timer) {
+        timer_t *next = timer->next;
+        wheel_insert(timer);
+        timer_stats.cascaded++;
+        timer = next;
+    }
+}
+
+// Initialize the wheel at the current tick
+void timer_init(void) {
+    for (uint32_t i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++) {
+        wheel[i] = NULL;
+    }
+    timer_jiffies = scheduler_get_ticks();
+    
+    timer_stats.pending = 0;
+    timer_stats.added = 0;
+    timer_stats.fired = 0;
+    timer_stats.cancelled = 0;
+    timer_stats.cascaded = 0;
+}
+
+// Arm (or re-arm) a timer for an absolute tick deadline
+void timer_add(timer_t *timer, void (*callback)(void *), void *data, uint32_t deadline) {
+    if (!timer || !callback) {
+        return;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    if (timer->pending) {
+        wheel_remove(timer);
+        timer_stats.pending--;
+    }
+    
+    timer->callback = callback;
+    timer->data = data;
+    timer->expires = deadline;
+    wheel_insert(timer);
+    timer_stats.pending++;
+    timer_stats.added++;
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+// Disarm a timer; returns 1 if it was pending. A callback already
+// running on the timer CPU is waited for, so the caller may free what
+// the callback uses once this returns.
+int timer_cancel(timer_t *timer) {
+    int was_pending = 0;
+    
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    if (timer && timer->pending) {
+        wheel_remove(timer);
+        timer_stats.pending--;
+        timer_stats.cancelled++;
+        was_pending = 1;
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    
+    while (timer_running == timer) {
+        cpu_relax();
+    }
+    
+    return was_pending;
+}
+
+// Ticks covering at least ms milliseconds
+uint32_t timer_ms_to_ticks(uint32_t ms) {
+    const uint32_t ms_per_tick = 1000 / TIMER_HZ;
+    return (ms / ms_per_tick) + (ms % ms_per_tick ? 1 : 0);
+}
+
+// Run every timer due by now. Level 0 is walked one tick at a time; when
+// its index wraps, the matching slot of the next level is cascaded down
+// (and so on upwards while those indices wrap too).
+void timer_tick(uint32_t now) {
+    spin_lock(&timer_lock);
+    if (timer_stats.pending == 0) {
+        timer_jiffies = now + 1;
+        spin_unlock(&timer_lock);
+        return;  // Nothing to cascade or fire
+    }
+    
+    while ((int32_t)(now - timer_jiffies) >= 0) {
+        uint32_t index = timer_jiffies & TIMER_SLOT_MASK;
+        
+        if (index == 0) {
+            for (uint32_t level = 1; level < TIMER_LEVELS; level++) {
+                uint32_t upper = (timer_jiffies >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK;
+                wheel_cascade(level, upper);
+                if (upper != 0) {
+                    break;
+                }
+            }
+        }
+        timer_jiffies++;
+        
+        // Callbacks run unlocked and may re-arm timers; those go to
+        // later slots
+        while (wheel[index]) {
+            timer_t *timer = wheel[index];
+            wheel_remove(timer);
+            timer_stats.pending--;
+            timer_stats.fired++;
+            
+            timer_running = timer;
+            spin_unlock(&timer_lock);
+            timer->callback(timer->data);
+            spin_lock(&timer_lock);
+            timer_running = NULL;
+        }
+    }
+    spin_unlock(&timer_lock);
+}
+
+// Get timer statistics
+void timer_get_stats(timer_stats_t *stats) {
+    if (stats) {
+        *stats = timer_stats;
+    }
+}
+
+// Print timer statistics
+void timer_print_stats(void) {
+    char buffer[64];
+    
+    console_puts("\n=== Timer Statistics ===\n");
+    
+    console_puts("Pending:              ");
+    itoa(timer_stats.pending, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Added:                ");
+    itoa(timer_stats.added, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Fired:                ");
+    itoa(timer_stats.fired, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Cancelled:            ");
+    itoa(timer_stats.cancelled, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Cascaded:             ");
+    itoa(timer_stats.cascaded, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+}
+
+// Benchmark callback; never runs since every timer is cancelled first
+static void bench_callback(void *data) {
+    (void)data;
+}
+
+// Insert into a deadline-sorted list (benchmark baseline)
+static void sorted_list_insert(timer_t **list, timer_t *timer) {
+    while (*list && (*list)->expires <= timer->expires) {
+        list = &(*list)->next;
+    }
+    timer->next = *list;
+    *list = timer;
+}
+
+// Compare add/cancel cost on the wheel with a sorted list while
+// TIMER_BENCH_COUNT timers are pending. Interrupts stay off throughout,
+// so no benchmark timer can fire.
+void timer_benchmark(void) {
+    char buffer[16];
+    
+    timer_t *timers = (timer_t *)malloc(TIMER_BENCH_COUNT * sizeof(timer_t));
+    if (!timers) {
+        console_puts("Error: Not enough memory for benchmark timers\n");
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    timer_stats_t saved = timer_stats;
+    uint32_t now = scheduler_get_ticks();
+    
+    // Deadlines spread over the first three levels
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < TIMER_BENCH_COUNT; i++) {
+        seed = seed * 1103515245 + 12345;
+        timers[i].pending = 0;
+        timers[i].expires = now + 1 + ((seed >> 8) & 0x3FFFF);
+    }
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < TIMER_BENCH_COUNT; i++) {
+        timer_add(&timers[i], bench_callback, NULL, timers[i].expires);
+    }
+    uint32_t add_cycles = (uint32_t)(rdtsc() - start);
+    
+    start = rdtsc();
+    for (uint32_t i = 0; i < TIMER_BENCH_COUNT; i++) {
+        timer_cancel(&timers[i]);
+    }
+    uint32_t cancel_cycles = (uint32_t)(rdtsc() - start);
+    
+    timer_t *list = NULL;
+    start = rdtsc();
+    for (uint32_t i = 0; i < TIMER_BENCH_COUNT; i++) {
+        sorted_list_insert(&list, &timers[i]);
+    }
+    uint32_t list_cycles = (uint32_t)(rdtsc() - start);
+    
+    timer_stats = saved;
+    irq_restore(flags);
+    free(timers);
+    
+    console_puts("\n=== Timer Benchmark (");
+    itoa(TIMER_BENCH_COUNT, buffer);
+    console_puts(buffer);
+    console_puts(" timers, cycles/op) ===\n");
+    
+    console_puts("Wheel add:            ");
+    itoa(add_cycles / TIMER_BENCH_COUNT, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Wheel cancel:         ");
+    itoa(cancel_cycles / TIMER_BENCH_COUNT, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+    
+    console_puts("Sorted list add:      ");
+    itoa(list_cycles / TIMER_BENCH_COUNT, buffer);
+    console_puts(buffer);
+    console_puts("\n");
+}
@@ -0,0 +1,64 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Timer wheel geometry: TIMER_LEVELS levels of TIMER_SLOTS slots, level n
+// slots are 64^n ticks wide. Deadlines up to TIMER_MAX_DELTA ticks ahead
+// (~46 hours at 100Hz) are exact, later ones are clamped to it.
+#define TIMER_HZ 100                // Scheduler tick rate (PIT channel 0)
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK (TIMER_SLOTS - 1)
+#define TIMER_LEVELS 4
+#define TIMER_MAX_DELTA ((1u << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1)
+#define TIMER_BENCH_COUNT 4096      // Timers armed by timer_benchmark()
+
+// One-shot timer; the owner provides the storage and must clear pending
+// before first use
+typedef struct timer {
+    struct timer *next;             // Next timer in the same wheel slot
+    struct timer *prev;             // Previous timer in the same wheel slot
+    uint32_t expires;               // Absolute deadline in scheduler ticks
+    uint32_t slot;                  // Wheel slot (level * TIMER_SLOTS + index)
+    void (*callback)(void *);       // Runs from the timer interrupt, interrupts off
+    void *data;                     // Argument for callback
+    uint8_t pending;                // 1 while queued on the wheel
+} timer_t;
+
+// Timer statistics
+typedef struct {
+    uint32_t pending;               // Timers currently on the wheel
+    uint32_t added;                 // timer_add() calls
+    uint32_t fired;                 // Callbacks run
+    uint32_t cancelled;             // Pending timers removed by timer_cancel()
+    uint32_t cascaded;              // Timers moved down a level
+} timer_stats_t;
+
+// Initialize the wheel at the current tick
+void timer_init(void);
+
+// Arm (or re-arm) a timer for an absolute tick deadline; deadlines that
+// already passed fire on the next tick
+void timer_add(timer_t *timer, void (*callback)(void *), void *data, uint32_t deadline);
+
+// Disarm a timer; returns 1 if it was pending, 0 if it already fired.
+// Waits out a callback in progress on another CPU, so it must not be
+// called from the timer's own callback.
+int timer_cancel(timer_t *timer);
+
+// Ticks covering at least ms milliseconds
+uint32_t timer_ms_to_ticks(uint32_t ms);
+
+// Run every timer due by now (scheduler tick, interrupts off)
+void timer_tick(uint32_t now);
+
+// Statistics
+void timer_get_stats(timer_stats_t *stats);
+void timer_print_stats(void);
+
+// Add/cancel cost with TIMER_BENCH_COUNT pending timers
+void timer_benchmark(void);
+
+#endif // TIMER_H
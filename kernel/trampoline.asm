@@ -0,0 +1,73 @@
+; Application processor entry. smp_boot_aps() copies everything between
+; ap_trampoline_start and ap_trampoline_end to SMP_TRAMPOLINE_BASE (smp.h)
+; and fills in the parameter block; the startup IPI starts the AP in real
+; mode at the first byte. Addresses inside the copy go through REL().
+
+GLOBAL ap_trampoline_start
+GLOBAL ap_trampoline_end
+GLOBAL ap_trampoline_params
+
+%define TRAMPOLINE_BASE 0x8000
+%define REL(x) (TRAMPOLINE_BASE + ((x) - ap_trampoline_start))
+
+SECTION .text
+
+BITS 16
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+
+    ; Flat segments, then protected mode
+    lgdt [REL(trampoline_gdt_ptr)]
+    mov eax, cr0
+    or eax, 0x1             ; CR0.PE
+    mov cr0, eax
+    jmp dword 0x08:REL(ap_protected)
+
+BITS 32
+ap_protected:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Same paging setup as paging_init(): 4MB pages, kernel directory, WP
+    mov eax, cr4
+    or eax, 0x10            ; CR4.PSE
+    mov cr4, eax
+    mov eax, [REL(ap_trampoline_params)]
+    mov cr3, eax
+    mov eax, cr0
+    or eax, 0x80010000      ; CR0.PG | CR0.WP
+    mov cr0, eax
+
+    ; Idle thread stack, then the kernel (never returns)
+    mov esp, [REL(ap_trampoline_params) + 4]
+    mov eax, [REL(ap_trampoline_params) + 8]
+    call eax
+
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+align 8
+trampoline_gdt:
+    dq 0x0000000000000000        ; NULL descriptor
+    dq 0x00cf9a000000ffff        ; Code segment (0x08)
+    dq 0x00cf92000000ffff        ; Data segment (0x10)
+
+trampoline_gdt_ptr:
+    dw trampoline_gdt_ptr - trampoline_gdt - 1
+    dd REL(trampoline_gdt)
+
+align 4
+ap_trampoline_params:
+    dd 0                    ; CR3 (kernel page directory)
+    dd 0                    ; Stack top
+    dd 0                    ; Entry point
+ap_trampoline_end:
@@ -0,0 +1,117 @@
+#include "waitqueue.h"
+#include "process.h"
+
+// Append a thread to the tail of wq
+static void wait_queue_push(wait_queue_t *wq, thread_t *thread) {
+    thread->wait_queue = wq;
+    thread->wait_next = NULL;
+    thread->wait_prev = wq->tail;
+    if (wq->tail) {
+        wq->tail->wait_next = thread;
+    } else {
+        wq->head = thread;
+    }
+    wq->tail = thread;
+    wq->count++;
+}
+
+// Unlink a thread from the wait queue it is on
+static void wait_queue_unlink(thread_t *thread) {
+    wait_queue_t *wq = thread->wait_queue;
+    
+    if (thread->wait_prev) {
+        thread->wait_prev->wait_next = thread->wait_next;
+    } else {
+        wq->head = thread->wait_next;
+    }
+    if (thread->wait_next) {
+        thread->wait_next->wait_prev = thread->wait_prev;
+    } else {
+        wq->tail = thread->wait_prev;
+    }
+    
+    thread->wait_queue = NULL;
+    thread->wait_next = NULL;
+    thread->wait_prev = NULL;
+    wq->count--;
+}
+
+// Initialize an empty wait queue
+void wait_queue_init(wait_queue_t *wq) {
+    wq->head = NULL;
+    wq->tail = NULL;
+    wq->count = 0;
+    spin_init(&wq->lock);
+}
+
+// Block the current thread on wq until a wake; a direct thread_wake()
+// leaves it linked, so it unlinks itself
+void wait_queue_sleep(wait_queue_t *wq) {
+    thread_t *self = process_current_thread();
+    
+    wait_queue_push(wq, self);
+    thread_block(&wq->lock);
+    if (self->wait_queue) {
+        wait_queue_unlink(self);
+    }
+}
+
+// Block on wq with the thread timer armed; on timeout the thread is
+// still linked and takes itself off the queue
+int wait_queue_sleep_until(wait_queue_t *wq, uint32_t deadline) {
+    thread_t *self = process_current_thread();
+    
+    wait_queue_push(wq, self);
+    int woken = thread_block_timeout(deadline, &wq->lock);
+    if (self->wait_queue) {
+        wait_queue_unlink(self);
+    }
+    return woken;
+}
+
+// Wake the longest waiter
+uint32_t wake_one(wait_queue_t *wq) {
+    uint32_t woken = 0;
+    
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    if (wq->head) {
+        thread_t *thread = wq->head;
+        wait_queue_unlink(thread);
+        thread_wake(thread);
+        woken = 1;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+    
+    return woken;
+}
+
+// Wake every waiter, oldest first
+uint32_t wake_all(wait_queue_t *wq) {
+    uint32_t woken = 0;
+    
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    while (wq->head) {
+        thread_t *thread = wq->head;
+        wait_queue_unlink(thread);
+        thread_wake(thread);
+        woken++;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+    
+    return woken;
+}
+
+// Take a thread off whatever wait queue it is on; the queue may change
+// until its lock is held, so check again under it
+void wait_queue_remove(thread_t *thread) {
+    uint32_t flags = irq_save();
+    wait_queue_t *wq = thread->wait_queue;
+    if (wq) {
+        spin_lock(&wq->lock);
+        if (thread->wait_queue == wq) {
+            wait_queue_unlink(thread);
+        }
+        spin_unlock(&wq->lock);
+    }
+    irq_restore(flags);
+}
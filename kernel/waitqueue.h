@@ -0,0 +1,71 @@
+#ifndef WAITQUEUE_H
+#define WAITQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+#include "spinlock.h"
+#include "scheduler.h"
+#include "timer.h"
+
+struct thread;
+
+// FIFO of threads blocked until some condition becomes true. Threads on
+// a wait queue are THREAD_BLOCKED and off the run queue. The lock guards
+// the list and is the lock wakeup conditions are checked under.
+typedef struct wait_queue {
+    struct thread *head;            // Longest waiter (woken first)
+    struct thread *tail;            // Newest waiter
+    uint32_t count;                 // Threads waiting
+    spinlock_t lock;
+} wait_queue_t;
+
+// Initialize an empty wait queue
+void wait_queue_init(wait_queue_t *wq);
+
+// Block the current thread on wq until woken; the caller holds wq->lock
+// with interrupts off, and holds it again on return
+void wait_queue_sleep(wait_queue_t *wq);
+
+// Same, but also wake at an absolute tick deadline; returns 0 once the
+// deadline passed, 1 if woken first
+int wait_queue_sleep_until(wait_queue_t *wq, uint32_t deadline);
+
+// Wake the longest waiter / every waiter; return the number woken
+// (safe from interrupt handlers; take wq->lock, so not with it held)
+uint32_t wake_one(wait_queue_t *wq);
+uint32_t wake_all(wait_queue_t *wq);
+
+// Take a thread off whatever wait queue it is on (termination)
+void wait_queue_remove(struct thread *thread);
+
+// Sleep on wq until condition holds. The condition is checked under
+// wq->lock with interrupts off, so a wake between the check and the
+// sleep is not lost.
+#define wait_event(wq, condition)                                       \
+    do {                                                                \
+        uint32_t __wait_flags = spin_lock_irqsave(&(wq)->lock);         \
+        while (!(condition)) {                                          \
+            wait_queue_sleep(wq);                                       \
+        }                                                               \
+        spin_unlock_irqrestore(&(wq)->lock, __wait_flags);              \
+    } while (0)
+
+// Like wait_event(), giving up after timeout_ms; evaluates to 1 if the
+// condition holds, 0 on timeout
+#define wait_event_timeout(wq, condition, timeout_ms)                   \
+    ({                                                                  \
+        uint32_t __wait_deadline = scheduler_get_ticks() + timer_ms_to_ticks(timeout_ms); \
+        uint32_t __wait_flags = spin_lock_irqsave(&(wq)->lock);         \
+        int __wait_done;                                                \
+        while (!(__wait_done = !!(condition))) {                        \
+            if (!wait_queue_sleep_until(wq, __wait_deadline)) {         \
+                __wait_done = !!(condition);                            \
+                break;                                                  \
+            }                                                           \
+        }                                                               \
+        spin_unlock_irqrestore(&(wq)->lock, __wait_flags);              \
+        __wait_done;                                                    \
+    })
+
+#endif // WAITQUEUE_H